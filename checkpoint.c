@@ -0,0 +1,69 @@
+/* File: checkpoint.c
+ * =-=-=-=-=-=-=-=-=-
+ * Keeps track of how far a print job got, so it can be resumed.
+ */
+
+// Library Imports
+#include "malloc.h"
+#include "printf.h"
+
+// Project Imports
+#include "checkpoint.h"
+
+// Checkpoint of the last job printed
+struct checkpoint checkpoint;
+
+/* Function: checkpoint_start()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Records the job (replacing the copy of the last one), with nothing
+ * placed and nothing used yet.
+ */
+void checkpoint_start(struct checkpoint *checkpoint, unsigned int image, unsigned int colormap, unsigned int scale, const struct placement_list *list) {
+    checkpoint->valid = true;
+    checkpoint->image = image;
+    checkpoint->colormap = colormap;
+    checkpoint->scale = scale;
+    if(checkpoint->job) placement_free(checkpoint->job);
+    checkpoint->job = placement_copy(list);
+    checkpoint->next = 0;
+    checkpoint->count = list->count;
+    for(int c = 0; c < PLACEMENT_MAX_CARTRIDGES; c++) checkpoint->used[c] = 0;
+    checkpoint->x = 0;
+    checkpoint->y = 0;
+    checkpoint->z = 0;
+}
+
+/* Function: checkpoint_matches()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Checks the selection against the checkpoint (the job itself is the
+ * checkpoint's own copy, so there is nothing to check it against).
+ */
+bool checkpoint_matches(const struct checkpoint *checkpoint, unsigned int image, unsigned int colormap, unsigned int scale) {
+    return checkpoint->valid && checkpoint->job && checkpoint->image == image && checkpoint->colormap == colormap
+           && checkpoint->scale == scale;
+}
+
+/* Function: checkpoint_placed()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Counts the brick against its cartridge, and moves the cursor past it
+ * (placing a brick again leaves the cursor where it is).
+ */
+void checkpoint_placed(struct checkpoint *checkpoint, const struct placement_list *list, unsigned int brick, int x, int y, int z) {
+    unsigned int c = list->bricks[brick].cartridge;
+    if(c < PLACEMENT_MAX_CARTRIDGES) checkpoint->used[c]++;
+    if(brick >= checkpoint->next) checkpoint->next = brick + 1;
+    checkpoint->x = x;
+    checkpoint->y = y;
+    checkpoint->z = z;
+}
+
+/* Function: checkpoint_print()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Prints where the job stopped and what it used.
+ */
+void checkpoint_print(const struct checkpoint *checkpoint) {
+    printf("Checkpoint: %d of %d bricks placed, machine at (%d, %d, %d)\n", checkpoint->next, checkpoint->count, checkpoint->x, checkpoint->y, checkpoint->z);
+    for(int c = 0; c < PLACEMENT_MAX_CARTRIDGES; c++) {
+        if(checkpoint->used[c]) printf("  cartridge %d: %d bricks used\n", c, checkpoint->used[c]);
+    }
+}
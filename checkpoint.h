@@ -0,0 +1,87 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+/*
+ * Checkpoints of print jobs. While a job prints, its checkpoint records
+ * which job it is, the next brick of its placement list to place, how
+ * many bricks it took from each cartridge, and where the machine was
+ * after the last brick. If the print stops early (a fault, or the
+ * machine being reset mid-print while the Pi stays on), the job can be
+ * resumed from the next unplaced brick, or any range of its bricks
+ * placed again, instead of starting over. The checkpoint keeps its own
+ * copy of the job's placement list and color map, so a resume places
+ * exactly the bricks of the half-built print from the same cartridges,
+ * even if the same selection would now quantize differently (fewer
+ * bricks left in a cartridge) or the AUTO color map picked others.
+ *
+ * The checkpoint lives in RAM, so it does not survive a power cycle.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+
+// Project Imports
+#include "placement.h"
+
+// Contains the job a checkpoint belongs to (and its placement list), the `next` brick to place, the bricks `used`
+// from each cartridge, and the position {x, y, z} of the machine after the last placed brick
+struct checkpoint {
+    bool valid;
+    unsigned int image, colormap, scale;
+    struct placement_list *job;
+    unsigned int next, count;
+    unsigned int used[PLACEMENT_MAX_CARTRIDGES];
+    int x, y, z;
+};
+
+extern struct checkpoint checkpoint;
+
+/*
+ * `checkpoint_start`
+ *
+ * Starts a fresh checkpoint for a job, with no bricks placed (keeping a copy of its placement list).
+ *
+ * @param checkpoint  the checkpoint to start
+ * @param image       the index of the image in BITMAP_LIST
+ * @param colormap    the index of the color map in PRINTER_LIST
+ * @param scale       the index of the scale mode in SCALE_MODE_LIST
+ * @param list        the placement list of the job
+ */
+void checkpoint_start(struct checkpoint *checkpoint, unsigned int image, unsigned int colormap, unsigned int scale, const struct placement_list *list);
+
+/*
+ * `checkpoint_matches`
+ *
+ * @param checkpoint  the checkpoint to check
+ * @param image       the index of the image in BITMAP_LIST
+ * @param colormap    the index of the color map in PRINTER_LIST
+ * @param scale       the index of the scale mode in SCALE_MODE_LIST
+ *
+ * @return            true if `checkpoint` holds a job of the selection (resume with `checkpoint->job`)
+ */
+bool checkpoint_matches(const struct checkpoint *checkpoint, unsigned int image, unsigned int colormap, unsigned int scale);
+
+/*
+ * `checkpoint_placed`
+ *
+ * Records that a brick of the job was placed, with the machine at {x, y, z}.
+ *
+ * @param checkpoint  the checkpoint of the job
+ * @param list        the placement list of the job
+ * @param brick       the index of the placed brick in `list`
+ * @param x           the X position of the machine
+ * @param y           the Y position of the machine
+ * @param z           the Z position of the machine
+ */
+void checkpoint_placed(struct checkpoint *checkpoint, const struct placement_list *list, unsigned int brick, int x, int y, int z);
+
+/*
+ * `checkpoint_print`
+ *
+ * Prints a checkpoint over UART.
+ *
+ * @param checkpoint  the checkpoint to print
+ */
+void checkpoint_print(const struct checkpoint *checkpoint);
+
+#endif
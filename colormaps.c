@@ -8,7 +8,7 @@
 #include "colormaps.h"
 
 // Constant number of printers available
-const unsigned int NUM_PRINTERS = 4;
+const unsigned int NUM_PRINTERS = 5;
 
 // Default blue printer -> utilizes 28 Color LEGO Palette obtained from Amazon
 const unsigned int S_DEFAULT_BLUE = 28;
@@ -67,7 +67,29 @@ struct printer P_MOD_BLUE = {
     .list_cartridges = C_MOD_BLUE,
 };
 
+// Adaptive printer -> the cartridges of the inventory that best fit the job being previewed (empty until one is)
+struct cartridge C_AUTO[AUTO_MAX_CARTRIDGES];
+
+// `P_AUTO` initialization
+struct printer P_AUTO = {
+    .name_printer = "AUTO",
+    .num_cartridges = 0,
+    .list_cartridges = C_AUTO,
+};
+
 // List of all printers
 const struct printer* PRINTER_LIST[] = {
-    &P_NONE, &P_RAINBOW, &P_DEFAULT_BLUE, &P_MOD_BLUE,
+    &P_NONE, &P_RAINBOW, &P_DEFAULT_BLUE, &P_MOD_BLUE, &P_AUTO,
 };
+
+/* Function: cartridge_index()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns the index of the first cartridge in `color_map` with the
+ * color `color`, or -1 if no cartridge matches.
+ */
+int cartridge_index(const struct printer *color_map, unsigned int color) {
+    for(int j = 0; j < color_map->num_cartridges; j++) {
+        if(color_map->list_cartridges[j].color == color) return j;
+    }
+    return -1;
+}
@@ -13,9 +13,12 @@
 // Standard Library Imports
 #include <stddef.h>
 
-// Contains a `color` and `capacity`
+// Contains a `color` and `capacity`, the bricks reserved by print jobs, and the cartridge the bricks come from if it
+// is a copy (see `inventory.h`)
 struct cartridge {
 	unsigned int color, capacity;
+	unsigned int reserved;
+	struct cartridge *stock;
 };
 
 // Contains a `num_cartidges`, `list_cartridges`, and `name_printer`
@@ -25,7 +28,11 @@ struct printer {
     const char* name_printer;
 };
 
+// Most cartridges the adaptive printer (filled in per job by `palette_select` of `img_process.h`) can pick
+#define AUTO_MAX_CARTRIDGES 30
+
 // List of printers, an array of all printers, and the total number of printers available
+extern struct printer P_AUTO;
 extern struct printer P_MOD_BLUE;
 extern struct printer P_DEFAULT_BLUE;
 extern struct printer P_RAINBOW;
@@ -33,4 +40,16 @@ extern struct printer P_NONE;
 extern const struct printer* PRINTER_LIST[];
 extern const unsigned int NUM_PRINTERS;
 
+/*
+ * `cartridge_index`
+ *
+ * Finds the first cartridge of a color map holding bricks of a color.
+ *
+ * @param color_map   the color map to search
+ * @param color       the color to look for
+ *
+ * @return            the index of the cartridge, or -1 if no cartridge has that color
+ */
+int cartridge_index(const struct printer *color_map, unsigned int color);
+
 #endif
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 // Library Imports
 #include "console.h"
+#include "gpio_interrupt.h"
 #include "interrupts.h"
 #include "keyboard.h"
 #include "shell.h"
@@ -18,18 +19,21 @@
 #include "bitmaps.h"
 #include "colormaps.h"
 #include "img_process.h"
+#include "input_log.h"
 #include "printer.h"
 #include "printer_assets.h"
 #include "printer_driver.h"
 
 // Constants
 #define NA -1
+#define REPLAY_SESSION false // !! IMPORTANT -> (change to true to replay the session in input_session.c before reading the keyboard)
 
 // Main Executon
 void main(void) {
     // Asset Initialization:
     interrupts_init();
     gpio_init();
+    gpio_interrupt_init();
     timer_init();
     uart_init();
 
@@ -41,8 +45,10 @@ void main(void) {
     // Keyboard Initialization:
     keyboard_init(KEYBOARD_CLOCK, KEYBOARD_DATA);
     
-    // Printer Initialization:
-    printer_init(keyboard_read_next);
+    // Printer Initialization (recording every key, so the session can be dumped and replayed):
+    input_fn_t read_fn = keyboard_read_next;
+    if(REPLAY_SESSION) read_fn = input_replay(INPUT_SESSION, INPUT_SESSION_SIZE, true, keyboard_read_next);
+    printer_init(input_record(read_fn));
     interrupts_global_enable();
     printer_run();
 }
@@ -0,0 +1,136 @@
+/* File: feeder_layout.c
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Plans the feeder layout for a print job, assigning the busiest
+ * cartridges to the slots with the least travel to the bricks they are
+ * placed at.
+ */ 
+
+// Library Imports
+#include "printf.h"
+
+// Project Imports
+#include "feeder_layout.h"
+#include "kinematics.h"
+#include "printer_driver.h"
+
+// Slot map used while printing (identity until a layout is applied)
+static unsigned int slot_map[FEEDER_SLOTS];
+static bool slot_map_applied = false;
+
+/* Function: slot_position()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns the machine coordinate of physical feeder slot `slot`.
+ */
+static coordinate slot_position(unsigned int slot) {
+    coordinate pickup;
+    pickup.x = machine.feeder_x + (machine.feeder_pitch * slot);
+    pickup.y = machine.feeder_y;
+    return pickup;
+}
+
+/* Function: travel()
+ * =-=-=-=-=-=-=-=-=-
+ * Returns the steps traveled going from `from` to `to` and back. The X
+ * and Y axes move at the same time, so only the longer axis counts.
+ */
+static unsigned long travel(coordinate from, coordinate to) {
+    unsigned long dx = (from.x > to.x) ? from.x - to.x : to.x - from.x;
+    unsigned long dy = (from.y > to.y) ? from.y - to.y : to.y - from.y;
+    return 2 * ((dx > dy) ? dx : dy);
+}
+
+/* Function: feeder_plan()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Ranks the slots by their travel to every brick of the job, and hands
+ * them out to the cartridges in order of decreasing demand.
+ */
+void feeder_plan(const struct placement_list *list, struct feeder_layout *layout) {
+    unsigned int n = list->color_map->num_cartridges;
+    if(n > FEEDER_SLOTS) n = FEEDER_SLOTS;
+    layout->num_cartridges = n;
+    layout->identity_travel = 0;
+    layout->planned_travel = 0;
+    for(int c = 0; c < n; c++) layout->demand[c] = list->demand[c];
+
+    // Travel of every cartridge from every slot
+    unsigned long cost[FEEDER_SLOTS][FEEDER_SLOTS] = {{0}};
+    unsigned long slot_total[FEEDER_SLOTS] = {0};
+    for(int i = 0; i < list->count; i++) {
+        unsigned int c = list->bricks[i].cartridge;
+        if(c >= n) continue;
+
+        coordinate brick = brick_position(list->bricks[i].x, list->bricks[i].y);
+        for(int s = 0; s < n; s++) {
+            unsigned long t = travel(slot_position(s), brick);
+            cost[c][s] += t;
+            slot_total[s] += t;
+        }
+    }
+
+    // Order slots by least total travel, and cartridges by most demand
+    unsigned int slots[FEEDER_SLOTS], carts[FEEDER_SLOTS];
+    for(int i = 0; i < n; i++) {
+        slots[i] = i;
+        carts[i] = i;
+    }
+    for(int i = 0; i < n; i++) {
+        for(int j = i + 1; j < n; j++) {
+            if(slot_total[slots[j]] < slot_total[slots[i]]) {
+                unsigned int temp = slots[i];
+                slots[i] = slots[j];
+                slots[j] = temp;
+            }
+            if(layout->demand[carts[j]] > layout->demand[carts[i]]) {
+                unsigned int temp = carts[i];
+                carts[i] = carts[j];
+                carts[j] = temp;
+            }
+        }
+    }
+
+    // Pair them up and total the travel of both layouts
+    for(int i = 0; i < n; i++) layout->slot[carts[i]] = slots[i];
+    for(int c = 0; c < n; c++) {
+        layout->identity_travel += cost[c][c];
+        layout->planned_travel += cost[c][layout->slot[c]];
+    }
+}
+
+/* Function: feeder_saving()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns the percentage of travel saved by the planned layout.
+ */
+unsigned int feeder_saving(const struct feeder_layout *layout) {
+    if(!layout->identity_travel || layout->planned_travel >= layout->identity_travel) return 0;
+    return (layout->identity_travel - layout->planned_travel) * 100 / layout->identity_travel;
+}
+
+/* Function: feeder_apply()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Switches pickups over to the slots of `layout`.
+ */
+void feeder_apply(const struct feeder_layout *layout) {
+    printf("Feeder layout (%d%% less travel):\n", feeder_saving(layout));
+    for(int c = 0; c < layout->num_cartridges; c++) {
+        slot_map[c] = layout->slot[c];
+        printf("  cartridge %d (%d bricks) -> slot %d\n", c, layout->demand[c], layout->slot[c]);
+    }
+    slot_map_applied = true;
+}
+
+/* Function: feeder_reset()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Goes back to picking cartridge `i` up from slot `i`.
+ */
+void feeder_reset(void) {
+    slot_map_applied = false;
+}
+
+/* Function: feeder_pickup()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns the pickup position of `cartridge`.
+ */
+coordinate feeder_pickup(unsigned int cartridge) {
+    if(slot_map_applied && cartridge < FEEDER_SLOTS) return slot_position(slot_map[cartridge]);
+    return slot_position(cartridge);
+}
@@ -0,0 +1,79 @@
+#ifndef FEEDER_LAYOUT_H
+#define FEEDER_LAYOUT_H
+
+/*
+ * Functions for planning which feeder slot each cartridge of a color map
+ * is loaded into. Recommends a layout that keeps the colors a job needs
+ * most closest to the build plate to cut down on travel.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+
+// Project Imports
+#include "colormaps.h"
+#include "placement.h"
+#include "printer_driver.h"
+
+// Constants
+#define FEEDER_SLOTS 30
+
+// Contains the `slot` each cartridge sits in, the `demand` for each cartridge, and the travel of both layouts
+struct feeder_layout {
+    unsigned int num_cartridges;
+    unsigned int slot[FEEDER_SLOTS];
+    unsigned int demand[FEEDER_SLOTS];
+    unsigned long identity_travel, planned_travel;
+};
+
+/*
+ * `feeder_plan`
+ *
+ * Recommends a cartridge to slot assignment for printing a job, giving the cartridges with the
+ * highest demand the slots with the shortest travel to the bricks of the job.
+ *
+ * @param list        the placement list of the job
+ * @param layout      the layout filled in with the demand, recommended slots and estimated travel
+ */
+void feeder_plan(const struct placement_list *list, struct feeder_layout *layout);
+
+/*
+ * `feeder_saving`
+ *
+ * Returns the travel saved by the recommended layout over loading cartridge `i` into slot `i`.
+ *
+ * @param layout      the layout computed by `feeder_plan`
+ *
+ * @return            the saving as a percentage (0 - 100)
+ */
+unsigned int feeder_saving(const struct feeder_layout *layout);
+
+/*
+ * `feeder_apply`
+ *
+ * Copies the slots of `layout` into the slot map used for picking up bricks, and prints the layout over
+ * UART so the feeder can be loaded to match.
+ *
+ * @param layout      the layout computed by `feeder_plan`
+ */
+void feeder_apply(const struct feeder_layout *layout);
+
+/*
+ * `feeder_reset`
+ *
+ * Resets the slot map so cartridge `i` is picked up from slot `i`.
+ */
+void feeder_reset(void);
+
+/*
+ * `feeder_pickup`
+ *
+ * Returns the pickup position of a cartridge, going through the slot map.
+ *
+ * @param cartridge   the index of the cartridge within its color map
+ *
+ * @return            the machine coordinate to pick the brick up from
+ */
+coordinate feeder_pickup(unsigned int cartridge);
+
+#endif
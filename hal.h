@@ -0,0 +1,136 @@
+#ifndef HAL_H
+#define HAL_H
+
+/*
+ * Hardware abstraction layer for the printer's motion hardware. The
+ * stepper driver only talks to the step, direction and limit switch pins,
+ * the vacuum, and the stepper timer through these functions, so the same
+ * driver runs on the MangoPi (`hal_mango.c`) or against the virtual
+ * gantry on a laptop (`host/hal_host.c`).
+ *
+ * Axes are numbered as in `kinematics.h`.
+ */
+
+// Standard Library Imports
+#include <stdint.h>
+
+// Interrupt handler (same signature as the mango interrupt handlers)
+typedef void (*hal_handler_t)(uintptr_t pc, void *aux_data);
+
+/*
+ * `hal_steppers_init`
+ *
+ * Configures the step and direction pins of every axis as outputs.
+ */
+void hal_steppers_init(void);
+
+/*
+ * `hal_step_write`
+ *
+ * Drives the step pin of `axis` (the stepper driver steps on the rising edge).
+ *
+ * @param axis        the axis to step
+ * @param level       0 or 1
+ */
+void hal_step_write(int axis, int level);
+
+/*
+ * `hal_dir_write`
+ *
+ * Drives the direction pin of `axis`.
+ *
+ * @param axis        the axis to set the direction of
+ * @param level       1 to move towards positive positions, 0 towards the limit switch
+ */
+void hal_dir_write(int axis, int level);
+
+/*
+ * `hal_limits_init`
+ *
+ * Configures the limit switch of every axis to call its handler when the switch closes.
+ *
+ * @param handlers    one handler per axis, called with the switch already debounced
+ */
+void hal_limits_init(const hal_handler_t handlers[]);
+
+/*
+ * `hal_limit_read`
+ *
+ * @param axis        the axis to read the limit switch of
+ *
+ * @return            1 if the switch of `axis` is closed right now, 0 otherwise
+ */
+int hal_limit_read(int axis);
+
+/*
+ * `hal_limit_clear`
+ *
+ * Acknowledges the limit switch event of `axis` (call from its handler).
+ *
+ * @param axis        the axis whose event was handled
+ */
+void hal_limit_clear(int axis);
+
+/*
+ * `hal_vacuum_init`
+ *
+ * Configures the vacuum pin as an output.
+ */
+void hal_vacuum_init(void);
+
+/*
+ * `hal_vacuum_write`
+ *
+ * @param on          1 to switch the vacuum on, 0 to switch it off
+ */
+void hal_vacuum_write(int on);
+
+/*
+ * `hal_timer_init`
+ *
+ * Starts the periodic stepper timer, calling `handler` every `period_us` microseconds.
+ *
+ * @param period_us   microseconds between calls
+ * @param handler     the timer interrupt handler
+ */
+void hal_timer_init(unsigned int period_us, hal_handler_t handler);
+
+/*
+ * `hal_timer_clear`
+ *
+ * Acknowledges the stepper timer event (call from its handler).
+ */
+void hal_timer_clear(void);
+
+/*
+ * `hal_time_us`
+ *
+ * @return            microseconds since boot
+ */
+unsigned long hal_time_us(void);
+
+/*
+ * `hal_cycles`
+ *
+ * @return            CPU cycles since boot (at a rate only known by comparing with `hal_time_us`)
+ */
+unsigned long hal_cycles(void);
+
+/*
+ * `hal_delay_us`
+ *
+ * Waits `us` microseconds (interrupts keep running).
+ *
+ * @param us          microseconds to wait
+ */
+void hal_delay_us(unsigned long us);
+
+/*
+ * `hal_idle`
+ *
+ * Called from every loop that waits on the steppers. Nothing to do on the
+ * printer; the virtual gantry advances time here.
+ */
+void hal_idle(void);
+
+#endif
@@ -0,0 +1,102 @@
+/* File: hal_mango.c
+ * =-=-=-=-=-=-=-=-=-
+ * Motion hardware of the printer on the MangoPi: step and direction
+ * pins, limit switches, vacuum, and the stepper timer.
+ */
+
+// Standard Library Imports
+#include <stddef.h>
+
+// Library Imports
+#include "gpio.h"
+#include "gpio_extra.h"
+#include "gpio_interrupt.h"
+#include "hstimer.h"
+#include "interrupts.h"
+#include "timer.h"
+
+// Project Imports
+#include "hal.h"
+#include "kinematics.h"
+
+// Constants
+#define TICKS_PER_USEC 24
+
+// Pins (indexed by axis)
+static const gpio_id_t STEP_PINS[NUM_AXES] = { GPIO_PB4, GPIO_PB3, GPIO_PB2 };
+static const gpio_id_t DIR_PINS[NUM_AXES] = { GPIO_PD17, GPIO_PB6, GPIO_PB12 };
+static const gpio_id_t LIMIT_PINS[NUM_AXES] = { GPIO_PC0, GPIO_PC1, GPIO_PB11 };
+
+static const gpio_id_t VACUUM_PIN = GPIO_PB10;
+
+void hal_steppers_init(void) {
+    for(int axis = 0; axis < NUM_AXES; axis++) {
+        gpio_set_output(STEP_PINS[axis]);
+        gpio_set_output(DIR_PINS[axis]);
+    }
+}
+
+void hal_step_write(int axis, int level) {
+    gpio_write(STEP_PINS[axis], level);
+}
+
+void hal_dir_write(int axis, int level) {
+    gpio_write(DIR_PINS[axis], level);
+}
+
+void hal_limits_init(const hal_handler_t handlers[]) {
+    // switches pull the pin low when pressed (requires gpio_interrupt_init)
+    for(int axis = 0; axis < NUM_AXES; axis++) {
+        gpio_set_input(LIMIT_PINS[axis]);
+        gpio_set_pullup(LIMIT_PINS[axis]);
+        gpio_interrupt_config(LIMIT_PINS[axis], GPIO_INTERRUPT_NEGATIVE_EDGE, true);
+        gpio_interrupt_register_handler(LIMIT_PINS[axis], handlers[axis], NULL);
+        gpio_interrupt_enable(LIMIT_PINS[axis]);
+    }
+}
+
+int hal_limit_read(int axis) {
+    return gpio_read(LIMIT_PINS[axis]) == 0;
+}
+
+void hal_limit_clear(int axis) {
+    gpio_interrupt_clear(LIMIT_PINS[axis]);
+}
+
+void hal_vacuum_init(void) {
+    gpio_set_output(VACUUM_PIN);
+}
+
+void hal_vacuum_write(int on) {
+    gpio_write(VACUUM_PIN, on);
+}
+
+void hal_timer_init(unsigned int period_us, hal_handler_t handler) {
+    // armtimer is intialized to number of usecs between events
+    hstimer_init(HSTIMER0, period_us);
+    hstimer_enable(HSTIMER0);             // enable timer itself
+    interrupts_register_handler(INTERRUPT_SOURCE_HSTIMER0, handler, NULL);
+    interrupts_enable_source(INTERRUPT_SOURCE_HSTIMER0);
+}
+
+void hal_timer_clear(void) {
+    hstimer_interrupt_clear(HSTIMER0);
+}
+
+unsigned long hal_time_us(void) {
+    return timer_get_ticks() / TICKS_PER_USEC;
+}
+
+unsigned long hal_cycles(void) {
+    // cycle CSR of the C906 core
+    unsigned long cycles;
+    __asm__ volatile("rdcycle %0" : "=r"(cycles));
+    return cycles;
+}
+
+void hal_delay_us(unsigned long us) {
+    timer_delay_us(us);
+}
+
+void hal_idle(void) {
+}
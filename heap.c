@@ -0,0 +1,132 @@
+/* File: heap.c
+ * =-=-=-=-=-=-=
+ * Call site tagging and leak reports for the UI's allocations.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+#include <stddef.h>
+
+// Library Imports
+#include "malloc.h"
+#include "printf.h"
+
+// Project Imports (heap.h routes malloc and free through the wrapper, which needs the real ones)
+#include "heap.h"
+#undef malloc
+#undef free
+
+// Constants
+#define BLOCK_MAGIC 0x4845ab1e
+
+// Header in front of every tracked block: the live list, its call site, size, and the frame it was allocated in
+struct block {
+    struct block *prev, *next;
+    unsigned int magic, site;
+    size_t size;
+    unsigned int frame;
+    bool reported;
+};
+
+// Contains a call site and how much of the heap it holds (the last site also counts every site after it)
+struct site {
+    const char *file;
+    int line;
+    unsigned int allocs, live_blocks;
+    size_t live_bytes;
+};
+
+static struct site sites[HEAP_SITES];
+static unsigned int num_sites;
+static struct block *live;
+static struct heap_stats stats;
+static size_t frame_start_bytes;
+static unsigned int frame_start_allocs;
+
+/* Function: find_site()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Returns the index of a call site, adding it if it is new.
+ */
+static unsigned int find_site(const char *file, int line) {
+    for(unsigned int i = 0; i < num_sites; i++) {
+        if(sites[i].line == line && sites[i].file == file) return i;
+    }
+    if(num_sites == HEAP_SITES) return HEAP_SITES - 1;
+    sites[num_sites].file = file;
+    sites[num_sites].line = line;
+    return num_sites++;
+}
+
+void *heap_malloc(size_t size, const char *file, int line) {
+    struct block *block = malloc(sizeof(struct block) + size);
+    if(!block) return NULL;
+    block->magic = BLOCK_MAGIC;
+    block->site = find_site(file, line);
+    block->size = size;
+    block->frame = stats.frames;
+    block->reported = false;
+    block->prev = NULL;
+    block->next = live;
+    if(live) live->prev = block;
+    live = block;
+
+    struct site *site = &sites[block->site];
+    site->allocs++;
+    site->live_blocks++;
+    site->live_bytes += size;
+    stats.allocs++;
+    stats.live_blocks++;
+    stats.live_bytes += size;
+    if(stats.live_bytes > stats.peak_bytes) stats.peak_bytes = stats.live_bytes;
+    return block + 1;
+}
+
+void heap_free(void *ptr) {
+    if(!ptr) return;
+    struct block *block = (struct block *)ptr - 1;
+    if(block->magic != BLOCK_MAGIC) {
+        printf("Heap: free of untracked block %p ignored\n", ptr);
+        return;
+    }
+    block->magic = 0;
+    if(block->prev) block->prev->next = block->next;
+    else live = block->next;
+    if(block->next) block->next->prev = block->prev;
+
+    struct site *site = &sites[block->site];
+    site->live_blocks--;
+    site->live_bytes -= block->size;
+    stats.live_blocks--;
+    stats.live_bytes -= block->size;
+    free(block);
+}
+
+void heap_frame(void) {
+    stats.frame_allocs = stats.allocs - frame_start_allocs;
+    frame_start_allocs = stats.allocs;
+    stats.frame_growth = (long)stats.live_bytes - (long)frame_start_bytes;
+    frame_start_bytes = stats.live_bytes;
+    stats.frames++;
+
+    for(struct block *block = live; block; block = block->next) {
+        if(!block->reported && stats.frames - block->frame >= HEAP_STALE_FRAMES) {
+            block->reported = true;
+            printf("Heap: %d bytes from %s:%d alive for %d frames\n", (int)block->size, sites[block->site].file,
+                   sites[block->site].line, HEAP_STALE_FRAMES);
+        }
+    }
+}
+
+const struct heap_stats *heap_get_stats(void) {
+    return &stats;
+}
+
+void heap_report(void) {
+    printf("Heap: %d bytes in %d blocks live, peak %d bytes, %d allocations in the last frame (live bytes %s%ld)\n",
+           (int)stats.live_bytes, stats.live_blocks, (int)stats.peak_bytes, stats.frame_allocs,
+           stats.frame_growth < 0 ? "-" : "+", stats.frame_growth < 0 ? -stats.frame_growth : stats.frame_growth);
+    for(unsigned int i = 0; i < num_sites; i++) {
+        printf("  %s:%d: %d allocations, %d bytes in %d blocks live\n", sites[i].file, sites[i].line, sites[i].allocs,
+               (int)sites[i].live_bytes, sites[i].live_blocks);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+/*
+ * Heap accounting for the UI. Included after "malloc.h", it routes
+ * `malloc` and `free` through a wrapper that tags every block with its
+ * call site and keeps live bytes, peak bytes, and allocations per frame
+ * of `printer_run`. A block still alive HEAP_STALE_FRAMES frames after
+ * it was allocated is reported over UART as a likely leak, so steady
+ * state use of the UI should show no heap growth at all.
+ *
+ * Only the files that include this header are tracked; blocks from
+ * other modules must be freed by those modules (as they already are).
+ */
+
+// Standard Library Imports
+#include <stddef.h>
+
+// Constants
+#define HEAP_SITES 32
+#define HEAP_STALE_FRAMES 8
+
+// Contains the heap use of the tracked files: bytes and blocks alive now, the most bytes ever alive, all
+// allocations so far, those of the last finished frame, and the bytes the live set grew by over that frame
+struct heap_stats {
+    size_t live_bytes, peak_bytes;
+    unsigned int live_blocks, allocs, frame_allocs, frames;
+    long frame_growth;
+};
+
+/*
+ * `heap_malloc`
+ *
+ * Allocates `size` bytes on behalf of the call site `file`:`line`.
+ *
+ * @param size        the bytes to allocate
+ * @param file        the file calling malloc
+ * @param line        the line calling malloc
+ *
+ * @return            the block, or NULL if the heap is out of space
+ */
+void *heap_malloc(size_t size, const char *file, int line);
+
+/*
+ * `heap_free`
+ *
+ * Frees a block from `heap_malloc` (NULL is ignored, anything else is reported and left alone).
+ *
+ * @param ptr         the block to free
+ */
+void heap_free(void *ptr);
+
+/*
+ * `heap_frame`
+ *
+ * Ends a frame of the UI, reporting blocks that have now been alive for HEAP_STALE_FRAMES frames.
+ */
+void heap_frame(void);
+
+/*
+ * `heap_get_stats`
+ *
+ * @return            the heap use so far
+ */
+const struct heap_stats *heap_get_stats(void);
+
+/*
+ * `heap_report`
+ *
+ * Prints the heap use, and the live blocks and bytes of every call site, over UART.
+ */
+void heap_report(void);
+
+// Route the allocations of the including file through the wrapper
+#define malloc(size) heap_malloc((size), __FILE__, __LINE__)
+#define free(ptr) heap_free(ptr)
+
+#endif
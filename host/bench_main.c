@@ -0,0 +1,164 @@
+/* File: bench_main.c
+ * =-=-=-=-=-=-=-=-=-
+ * Benchmarks the image processing library on the host: every stage of
+ * the preview and print pipelines over every image in BITMAP_LIST, at
+ * the 80, 40 and 20 pixel sizes the UI uses, and every color map in
+ * PRINTER_LIST. Prints one CSV row per measurement (to track
+ * regressions, compare the rows of two runs):
+ *
+ *     stage,image,size,colormap,calls,pixels,ns_per_call,mpixels_per_s,allocs_per_call
+ *
+ * where `pixels` is the number of pixels one call produces.
+ */
+
+// Standard Library Imports
+#include <stdio.h>
+#include <time.h>
+
+// Library Imports
+#include "malloc.h"
+
+// Project Imports
+#include "bitmaps.h"
+#include "colormaps.h"
+#include "heap.h"
+#include "img_process.h"
+
+// Constants
+#define MIN_NS 20000000L // time each measurement for at least 20 ms
+#define MIN_CALLS 3
+#define PREVIEW_SIZE 240 // images are scaled up to this many pixels on screen
+static const unsigned int SIZES[] = { 80, 40, 20 };
+#define NUM_SIZES (sizeof(SIZES) / sizeof(SIZES[0]))
+
+// Contains the inputs of a stage: the source image, the image scaled to the measured size, and a color map
+struct bench_case {
+    const struct img *source, *scaled;
+    unsigned int size;
+    const struct printer *color_map;
+};
+
+// Runs a stage once, returning the image it made (freed by the benchmark), or NULL
+typedef struct img *(*stage_fn)(const struct bench_case *c);
+
+static struct img *stage_down_scale(const struct bench_case *c) {
+    return down_scale_image(c->source, c->size, c->size);
+}
+
+static struct img *stage_crop(const struct bench_case *c) {
+    return crop_image(c->scaled, 0, 0, c->size / 2, c->size / 2);
+}
+
+static struct img *stage_up_scale(const struct bench_case *c) {
+    return up_scale_image(c->scaled, PREVIEW_SIZE / c->size, PREVIEW_SIZE / c->size);
+}
+
+static struct img *stage_format(const struct bench_case *c) {
+    return format_image(c->scaled, c->color_map, false);
+}
+
+// Where `stage_palette` leaves its matches, so the calls are not optimized away
+volatile int palette_sink;
+
+static void match_pixels(const struct bench_case *c, enum color_space space) {
+    // The color matching kernel alone, on every pixel (without the background removal of `format_image`)
+    struct palette palette;
+    palette_pack(&palette, c->color_map, space);
+    for(unsigned int i = 0; i < c->scaled->width * c->scaled->height; i++) {
+        palette_sink = palette_nearest(&palette, c->scaled->pixels[i], false);
+    }
+}
+
+static struct img *stage_palette(const struct bench_case *c) {
+    match_pixels(c, SPACE_RGB);
+    return NULL;
+}
+
+static struct img *stage_palette_lab(const struct bench_case *c) {
+    match_pixels(c, SPACE_LAB);
+    return NULL;
+}
+
+// Where `stage_assign` leaves its matches
+int assign_sink[80 * 80]; // the largest of SIZES
+
+static struct img *stage_assign(const struct bench_case *c) {
+    // All of the pixels matched at once within the bricks available, as a printed job is
+    struct palette palette;
+    palette_pack(&palette, c->color_map, SPACE_LAB);
+    palette_assign(&palette, c->scaled->pixels, c->scaled->width * c->scaled->height, assign_sink);
+    return NULL;
+}
+
+// Where `stage_rank` leaves its scores
+struct colormap_ranking rank_sink;
+
+static struct img *stage_rank(const struct bench_case *c) {
+    colormap_rank(c->scaled, PRINTER_LIST, NUM_PRINTERS, &rank_sink);
+    return NULL;
+}
+
+// Where `stage_select` leaves its picks (the cartridges loaded in the feeder)
+#define SELECT_CARTRIDGES 9
+struct cartridge select_picks[SELECT_CARTRIDGES];
+struct printer select_sink = { 0, select_picks, "SELECT" };
+
+static struct img *stage_select(const struct bench_case *c) {
+    palette_select(c->scaled, &P_DEFAULT_BLUE, SELECT_CARTRIDGES, &select_sink);
+    return NULL;
+}
+
+/* Function: now_ns()
+ * =-=-=-=-=-=-=-=-=-
+ * Returns the host's monotonic clock in nanoseconds.
+ */
+static long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/* Function: measure()
+ * =-=-=-=-=-=-=-=-=-=
+ * Calls a stage until MIN_NS have passed (and at least MIN_CALLS
+ * times), freeing what it makes, and prints its row.
+ */
+static void measure(const char *stage, stage_fn fn, const struct bench_case *c, unsigned long pixels) {
+    unsigned int allocs = heap_get_stats()->allocs;
+    long calls = 0, start = now_ns(), elapsed;
+    do {
+        free(fn(c));
+        calls++;
+        elapsed = now_ns() - start;
+    } while(elapsed < MIN_NS || calls < MIN_CALLS);
+
+    double ns_per_call = (double)elapsed / calls;
+    printf("%s,%s,%d,%s,%ld,%lu,%.0f,%.3f,%.2f\n", stage, c->source->name, c->size,
+           c->color_map ? c->color_map->name_printer : "-", calls, pixels, ns_per_call,
+           pixels * 1000.0 / ns_per_call, (double)(heap_get_stats()->allocs - allocs) / calls);
+}
+
+int main(void) {
+    printf("stage,image,size,colormap,calls,pixels,ns_per_call,mpixels_per_s,allocs_per_call\n");
+    for(unsigned int b = 0; b < BITMAP_LIST_SIZE; b++) {
+        for(unsigned int s = 0; s < NUM_SIZES; s++) {
+            unsigned int size = SIZES[s];
+            struct img *scaled = down_scale_image(BITMAP_LIST[b], size, size);
+            struct bench_case c = { BITMAP_LIST[b], scaled, size, NULL };
+            measure("down_scale_image", stage_down_scale, &c, size * size);
+            measure("crop_image", stage_crop, &c, size * size / 4);
+            measure("up_scale_image", stage_up_scale, &c, PREVIEW_SIZE / size * size * PREVIEW_SIZE / size * size);
+            measure("colormap_rank", stage_rank, &c, size * size);
+            measure("palette_select", stage_select, &c, size * size);
+            for(unsigned int p = 0; p < NUM_PRINTERS; p++) {
+                c.color_map = PRINTER_LIST[p];
+                measure("format_image", stage_format, &c, size * size);
+                measure("palette_nearest", stage_palette, &c, size * size);
+                measure("palette_nearest_lab", stage_palette_lab, &c, size * size);
+                measure("palette_assign", stage_assign, &c, size * size);
+            }
+            free(scaled);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+# File: bitmaps_host.py
+# =-=-=-=-=-=-=-=-=-=-=
+# Writes stand-in images for the host builds, one for every image
+# declared in `bitmaps.h` (under the same name), to stdout as C. The
+# real `bitmaps.c` is made by `pyconversion/conversion.py` from photos
+# that are not in the repository, so the host builds (and the golden
+# file they are checked against) use these instead: a gradient of red
+# across and green down, a blue of its own per image, and a black grid
+# of squares. Integer math only, so the output never changes.
+#
+#     python3 host/bitmaps_host.py bitmaps.h > host/bitmaps_host.c
+
+# Libraries
+import re
+import sys
+
+# Constants
+A_COLOR = 0xff000000
+R_SHIFT = 16
+G_SHIFT = 8
+B_SHIFT = 0
+SIZES = [100, 160, 300, 1200]
+GRID = 10
+
+# Function: calc_pixel()
+# =-=-=-=-=-=-=-=-=-=-=-
+# Returns the pixel at {x, y} of the `index`th image, `size` pixels square.
+def calc_pixel(index, size, x, y):
+    if (x // GRID + y // GRID) % 5 == 0:
+        return A_COLOR
+    return A_COLOR | ((x * 255 // size) << R_SHIFT) | ((y * 255 // size) << G_SHIFT) | (((index * 37) & 0xff) << B_SHIFT)
+
+# Function: main()
+# =-=-=-=-=-=-=-=-
+# Writes a struct for every image of the header given on the command line.
+def main():
+    names = re.findall(r'extern const struct img (\w+);', open(sys.argv[1]).read())
+    out = sys.stdout
+    out.write('#include "bitmaps.h"\n')
+    for index, name in enumerate(names):
+        size = SIZES[index % len(SIZES)]
+        pixels = ','.join(hex(calc_pixel(index, size, x, y)) for y in range(size) for x in range(size))
+        out.write(f'const struct img {name} = {{ .name = (char*)"{name}", .width = {size}, .height = {size}, .pixels = {{{pixels}}} }};\n')
+
+main()
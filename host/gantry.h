@@ -0,0 +1,87 @@
+#ifndef GANTRY_H
+#define GANTRY_H
+
+/*
+ * Virtual gantry behind the host backend of `hal.h`. Integrates the step
+ * pulses of the driver into physical axis positions, closes the limit
+ * switches when an axis reaches its switch, and advances virtual time by
+ * one stepper tick every time the driver idles. Records every brick the
+ * nozzle picks up and releases so a run can be checked against the job.
+ *
+ * Physical positions are in steps, with each limit switch closing at
+ * position 0 (so after homing they match the driver's positions).
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+
+// Project Imports
+#include "kinematics.h"
+
+// Constants
+#define GANTRY_MAX_EVENTS 4096
+
+// Where the nozzle was when it picked up or released a brick
+struct gantry_event {
+    unsigned long time_us;
+    int x, y, z;
+};
+
+/*
+ * `gantry_reset`
+ *
+ * Powers the gantry up at the physical position `start` with the vacuum off, time at zero
+ * and no recorded events.
+ *
+ * @param start       the physical position of each axis
+ */
+void gantry_reset(const int start[NUM_AXES]);
+
+/*
+ * `gantry_obstruct`
+ *
+ * Closes the limit switch of `axis` at virtual time `time_us` (as if the axis ran into something)
+ * and keeps it closed until the next `gantry_reset`.
+ *
+ * @param axis        the axis whose switch closes
+ * @param time_us     when it closes
+ */
+void gantry_obstruct(int axis, unsigned long time_us);
+
+/*
+ * `gantry_position`
+ *
+ * @param axis        the axis to read
+ *
+ * @return            the physical position of `axis` in steps
+ */
+int gantry_position(int axis);
+
+/*
+ * `gantry_steps`
+ *
+ * @param axis        the axis to read
+ *
+ * @return            the step pulses `axis` has received since the last reset
+ */
+unsigned long gantry_steps(int axis);
+
+/*
+ * `gantry_picks`
+ *
+ * @param events      set to the recorded pickups, in order
+ *
+ * @return            the number of bricks picked up since the last reset
+ */
+unsigned int gantry_picks(const struct gantry_event **events);
+
+/*
+ * `gantry_places`
+ *
+ * @param events      set to the recorded releases, in order
+ *
+ * @return            the number of bricks released since the last reset
+ */
+unsigned int gantry_places(const struct gantry_event **events);
+
+#endif
@@ -0,0 +1,167 @@
+/* File: gl_host.c
+ * =-=-=-=-=-=-=-=
+ * Host backend of the mango graphics library: an in-memory framebuffer
+ * that counts what every frame draws.
+ */
+
+// Standard Library Imports
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Library Imports
+#include "gl.h"
+
+// Project Imports
+#include "gl_host.h"
+
+// Constants (size of the mango font)
+#define CHAR_WIDTH 14
+#define CHAR_HEIGHT 16
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+// Screen state: the buffer shown and the one drawn into (the same one in GL_SINGLEBUFFER mode)
+static int screen_width, screen_height;
+static color_t *front, *back;
+static color_t *buffers[2];
+
+// Counters of the frame being drawn
+static struct gl_frame_stats current;
+static gl_frame_fn on_frame;
+
+/* Function: now_ns()
+ * =-=-=-=-=-=-=-=-=-
+ * Returns the host's monotonic clock in nanoseconds.
+ */
+static long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/* Function: count_call()
+ * =-=-=-=-=-=-=-=-=-=-=-
+ * Counts a draw call, starting the frame's clock on its first one.
+ */
+static void count_call(void) {
+    if(!current.draw_calls) current.ns = now_ns();
+    current.draw_calls++;
+}
+
+/* Function: fill()
+ * =-=-=-=-=-=-=-=-
+ * Fills a rectangle of the back buffer, clipped to the screen.
+ */
+static void fill(int x, int y, int w, int h, color_t c) {
+    int x_end = x + w, y_end = y + h;
+    if(x < 0) x = 0;
+    if(y < 0) y = 0;
+    if(x_end > screen_width) x_end = screen_width;
+    if(y_end > screen_height) y_end = screen_height;
+    if(x >= x_end || y >= y_end) return;
+
+    current.pixels += (unsigned long)(x_end - x) * (y_end - y);
+    if(!back) return;
+    for(int row = y; row < y_end; row++) {
+        for(int col = x; col < x_end; col++) back[row * screen_width + col] = c;
+    }
+}
+
+/* Function: outline_char()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Stands in for a glyph: the outline of the character's cell, inset by
+ * a pixel (nothing for a space).
+ */
+static void outline_char(int x, int y, char ch, color_t c) {
+    if(ch == ' ') return;
+    fill(x + 1, y + 1, CHAR_WIDTH - 2, 1, c);
+    fill(x + 1, y + CHAR_HEIGHT - 2, CHAR_WIDTH - 2, 1, c);
+    fill(x + 1, y + 2, 1, CHAR_HEIGHT - 4, c);
+    fill(x + CHAR_WIDTH - 2, y + 2, 1, CHAR_HEIGHT - 4, c);
+}
+
+void gl_init(int width, int height, gl_mode_t mode) {
+    free(buffers[0]);
+    free(buffers[1]);
+    screen_width = width;
+    screen_height = height;
+    buffers[0] = calloc((size_t)width * height, sizeof(color_t));
+    buffers[1] = (mode == GL_DOUBLEBUFFER) ? calloc((size_t)width * height, sizeof(color_t)) : NULL;
+    front = buffers[0];
+    back = buffers[1] ? buffers[1] : buffers[0];
+}
+
+int gl_get_width(void) {
+    return screen_width;
+}
+
+int gl_get_height(void) {
+    return screen_height;
+}
+
+int gl_get_char_width(void) {
+    return CHAR_WIDTH;
+}
+
+int gl_get_char_height(void) {
+    return CHAR_HEIGHT;
+}
+
+void gl_swap_buffer(void) {
+    color_t *shown = back;
+    back = front;
+    front = shown;
+
+    // Frames with nothing drawn (a swap to show the same frame again) are not counted
+    if(!current.draw_calls) return;
+    current.ns = now_ns() - current.ns;
+    current.checksum = FNV_OFFSET;
+    for(int i = 0; shown && i < screen_width * screen_height; i++) current.checksum = (current.checksum ^ shown[i]) * FNV_PRIME;
+    if(on_frame) on_frame(&current);
+    current.frame++;
+    current.draw_calls = 0;
+    current.pixels = 0;
+}
+
+void gl_clear(color_t c) {
+    count_call();
+    fill(0, 0, screen_width, screen_height, c);
+}
+
+void gl_draw_pixel(int x, int y, color_t c) {
+    count_call();
+    fill(x, y, 1, 1, c);
+}
+
+void gl_draw_char(int x, int y, char ch, color_t c) {
+    count_call();
+    outline_char(x, y, ch, c);
+}
+
+void gl_draw_string(int x, int y, const char *str, color_t c) {
+    count_call();
+    for(; *str; str++, x += CHAR_WIDTH) outline_char(x, y, *str, c);
+}
+
+void gl_draw_rect(int x, int y, int w, int h, color_t c) {
+    count_call();
+    fill(x, y, w, h, c);
+}
+
+void gl_host_on_frame(gl_frame_fn fn) {
+    on_frame = fn;
+}
+
+int gl_host_snapshot(const char *path) {
+    if(!front || !current.frame) return -1;
+    FILE *file = fopen(path, "wb");
+    if(!file) return -1;
+    fprintf(file, "P6\n%d %d\n255\n", screen_width, screen_height);
+    for(int i = 0; i < screen_width * screen_height; i++) {
+        unsigned char rgb[3] = { front[i] >> 16, front[i] >> 8, front[i] };
+        fwrite(rgb, 1, sizeof(rgb), file);
+    }
+    fclose(file);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef GL_HOST_H
+#define GL_HOST_H
+
+/*
+ * Host backend of the mango graphics library: draws into an in-memory
+ * framebuffer (two of them in GL_DOUBLEBUFFER mode) instead of HDMI, and
+ * counts the draw calls and pixels written in every frame, a frame
+ * ending at each `gl_swap_buffer`. Text is drawn as the outline of each
+ * character's cell (there is no font on the host), so snapshots show the
+ * layout rather than the letters.
+ */
+
+// Counters of one frame: draw calls, pixels written (overdraw included), the host time from its first draw call
+// to its swap, and a checksum of what it shows
+struct gl_frame_stats {
+    unsigned long frame;
+    unsigned long draw_calls;
+    unsigned long pixels;
+    long ns;
+    unsigned int checksum;
+};
+
+// Called with the counters of every frame as it is swapped onto the screen
+typedef void (*gl_frame_fn)(const struct gl_frame_stats *stats);
+
+/*
+ * `gl_host_on_frame`
+ *
+ * Sets the function called at the end of every frame (NULL for none).
+ *
+ * @param fn          the function called with the frame's counters
+ */
+void gl_host_on_frame(gl_frame_fn fn);
+
+/*
+ * `gl_host_snapshot`
+ *
+ * Writes what is on the screen (the last frame swapped in) to a binary PPM file.
+ *
+ * @param path        the file to write
+ * @return            0 on success, -1 if nothing was drawn yet or the file cannot be written
+ */
+int gl_host_snapshot(const char *path);
+
+#endif
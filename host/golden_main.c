@@ -0,0 +1,265 @@
+/* File: golden_main.c
+ * =-=-=-=-=-=-=-=-=-=
+ * Golden output and performance regression harness for the image
+ * pipeline. Runs the preview and print quantization of every image in
+ * BITMAP_LIST, with every color map in PRINTER_LIST, every dithering
+ * mode and every scale mode in SCALE_MODE_LIST, exactly as `printer.c`
+ * does, and checks the
+ * checksums of the output pixels and placement lists against a golden
+ * file. Also times each stage (the best of RUNS runs over all cases) and
+ * fails if one got more than THRESHOLD_PCT percent slower than the
+ * timings recorded in the golden file.
+ *
+ *     ./host/golden check host/golden.txt     (exit 1 on any difference)
+ *     ./host/golden update host/golden.txt    (record the current outputs and timings)
+ *
+ * Timings depend on the machine, so record them on the machine that
+ * checks them (or check with `--no-timing`).
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Library Imports
+#include "malloc.h"
+
+// Project Imports
+#include "bitmaps.h"
+#include "colormaps.h"
+#include "heap.h"
+#include "img_process.h"
+#include "placement.h"
+#include "printer_assets.h"
+
+// Constants
+#define RUNS 5
+#define THRESHOLD_PCT 25
+#define SLACK_NS 1000000L // timings within a millisecond of the golden ones always pass
+#define AUTO_CARTRIDGES 9 // cartridges the AUTO color map picks (LOADED_FEEDER_SLOTS of `printer.c`)
+#define PREVIEW_SIZE 80
+#define MAX_CASES 4096
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+// Stages timed
+enum stage { STAGE_SCALE, STAGE_SELECT, STAGE_FORMAT, STAGE_PLACEMENT, NUM_STAGES };
+static const char *const STAGE_NAMES[NUM_STAGES] = { "scale", "select", "format", "placement" };
+
+// Contains the outputs of one image x color map x dithering mode x scale mode: checksums of the previewed and printed pixels and
+// of the placement list, and its number of bricks (print outputs are 0 in the preview-only scale mode)
+struct result {
+    char image[64], colormap[64], dither[64], scale[64];
+    unsigned int preview, print, placement, bricks;
+};
+
+static struct result results[MAX_CASES];
+static unsigned int num_results;
+static long stage_ns[NUM_STAGES];
+
+/* Function: now_ns()
+ * =-=-=-=-=-=-=-=-=-
+ * Returns the host's monotonic clock in nanoseconds.
+ */
+static long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/* Function: image_checksum()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Hashes the size and pixels of an image.
+ */
+static unsigned int image_checksum(const struct img *image) {
+    unsigned int hash = (FNV_OFFSET ^ image->width) * FNV_PRIME;
+    hash = (hash ^ image->height) * FNV_PRIME;
+    for(unsigned int i = 0; i < image->width * image->height; i++) hash = (hash ^ image->pixels[i]) * FNV_PRIME;
+    return hash;
+}
+
+/* Function: copy_name()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Copies a name into a result, replacing spaces so the golden file
+ * stays one field per name.
+ */
+static void copy_name(char *dest, unsigned int size, const char *name) {
+    snprintf(dest, size, "%s", name);
+    for(char *c = dest; *c; c++) if(*c == ' ') *c = '_';
+}
+
+/* Function: run_case()
+ * =-=-=-=-=-=-=-=-=-=-
+ * Runs the pipelines of `print_preview` and `print_printer` for one
+ * case, adding the time of each stage to `ns`.
+ */
+static void run_case(const struct img *bitmap, const struct printer *color_map, enum dither_mode dither, const struct scale_mode *scale,
+                     struct result *result, long ns[]) {
+    // The AUTO color map picks its cartridges for the job first (as `rank_colormaps` does)
+    long start;
+    if(color_map == &P_AUTO) {
+        start = now_ns();
+        struct img *job = down_scale_crop_image(bitmap, scale->scale, scale->x_start, scale->y_start, scale->width, scale->height);
+        ns[STAGE_SCALE] += now_ns() - start;
+        start = now_ns();
+        palette_select(job, &P_DEFAULT_BLUE, AUTO_CARTRIDGES, &P_AUTO);
+        ns[STAGE_SELECT] += now_ns() - start;
+        free(job);
+    }
+
+    // Preview: the image at 80x80 in the color map (without using up the cartridges)
+    start = now_ns();
+    struct img *preview = down_scale_image(bitmap, PREVIEW_SIZE, PREVIEW_SIZE);
+    ns[STAGE_SCALE] += now_ns() - start;
+    start = now_ns();
+    struct img *formatted = format_image_dithered(preview, color_map, false, dither);
+    ns[STAGE_FORMAT] += now_ns() - start;
+    result->preview = image_checksum(formatted);
+    free(formatted);
+    free(preview);
+
+    result->print = result->placement = result->bricks = 0;
+    if(scale == SCALE_MODE_LIST[0]) return;
+
+    // Print: the part of the image in the scale mode, quantized using up the cartridges, and its placement list
+    start = now_ns();
+    struct img *job = down_scale_crop_image(bitmap, scale->scale, scale->x_start, scale->y_start, scale->width, scale->height);
+    ns[STAGE_SCALE] += now_ns() - start;
+    start = now_ns();
+    struct img *quantized = format_image_dithered(job, color_map, true, dither);
+    ns[STAGE_FORMAT] += now_ns() - start;
+    start = now_ns();
+    struct placement_list *list = placement_build(quantized, color_map);
+    ns[STAGE_PLACEMENT] += now_ns() - start;
+    result->print = image_checksum(quantized);
+    result->placement = placement_checksum(list);
+    result->bricks = list->count;
+    placement_free(list);
+    free(quantized);
+    free(job);
+}
+
+/* Function: run_all()
+ * =-=-=-=-=-=-=-=-=-=
+ * Runs every case RUNS times, keeping the outputs and the best total
+ * time of each stage.
+ */
+static void run_all(void) {
+    for(int stage = 0; stage < NUM_STAGES; stage++) stage_ns[stage] = -1;
+    for(int run = 0; run < RUNS; run++) {
+        long ns[NUM_STAGES] = { 0 };
+        num_results = 0;
+        for(unsigned int b = 0; b < BITMAP_LIST_SIZE; b++) {
+            for(unsigned int p = 0; p < NUM_PRINTERS; p++) {
+                for(unsigned int d = 0; d < NUM_DITHER_MODES; d++) {
+                    for(unsigned int s = 0; s < NUM_SCALES && num_results < MAX_CASES; s++) {
+                        struct result *result = &results[num_results++];
+                        copy_name(result->image, sizeof(result->image), BITMAP_LIST[b]->name);
+                        copy_name(result->colormap, sizeof(result->colormap), PRINTER_LIST[p]->name_printer);
+                        copy_name(result->dither, sizeof(result->dither), DITHER_NAMES[d]);
+                        copy_name(result->scale, sizeof(result->scale), SCALE_MODE_LIST[s]->name);
+                        run_case(BITMAP_LIST[b], PRINTER_LIST[p], d, SCALE_MODE_LIST[s], result, ns);
+                    }
+                }
+            }
+        }
+        for(int stage = 0; stage < NUM_STAGES; stage++) {
+            if(stage_ns[stage] < 0 || ns[stage] < stage_ns[stage]) stage_ns[stage] = ns[stage];
+        }
+    }
+}
+
+/* Function: update()
+ * =-=-=-=-=-=-=-=-=-
+ * Writes the outputs and timings to the golden file.
+ */
+static int update(const char *path) {
+    FILE *golden = fopen(path, "w");
+    if(!golden) {
+        printf("Cannot write %s\n", path);
+        return 1;
+    }
+    fprintf(golden, "# image colormap dither scale preview print placement bricks\n");
+    for(unsigned int i = 0; i < num_results; i++) {
+        const struct result *r = &results[i];
+        fprintf(golden, "case %s %s %s %s %08x %08x %08x %u\n", r->image, r->colormap, r->dither, r->scale, r->preview, r->print,
+                r->placement, r->bricks);
+    }
+    fprintf(golden, "# stage best-of-%d total ns\n", RUNS);
+    for(int stage = 0; stage < NUM_STAGES; stage++) fprintf(golden, "time %s %ld\n", STAGE_NAMES[stage], stage_ns[stage]);
+    fclose(golden);
+    printf("Recorded %d cases in %s\n", num_results, path);
+    return 0;
+}
+
+/* Function: check()
+ * =-=-=-=-=-=-=-=-=
+ * Compares the outputs and timings with the golden file, printing every
+ * difference.
+ */
+static int check(const char *path, bool timing) {
+    FILE *golden = fopen(path, "r");
+    if(!golden) {
+        printf("No golden file %s (record one with `make golden-update`)\n", path);
+        return 1;
+    }
+
+    int failures = 0;
+    unsigned int checked = 0;
+    char line[512];
+    while(fgets(line, sizeof(line), golden)) {
+        struct result expected;
+        char stage[64];
+        long ns;
+        if(sscanf(line, "case %63s %63s %63s %63s %x %x %x %u", expected.image, expected.colormap, expected.dither, expected.scale,
+                  &expected.preview, &expected.print, &expected.placement, &expected.bricks) == 8) {
+            const struct result *r = NULL;
+            for(unsigned int i = 0; i < num_results && !r; i++) {
+                if(!strcmp(results[i].image, expected.image) && !strcmp(results[i].colormap, expected.colormap)
+                   && !strcmp(results[i].dither, expected.dither) && !strcmp(results[i].scale, expected.scale)) r = &results[i];
+            }
+            checked++;
+            if(!r) {
+                printf("MISSING %s %s %s %s\n", expected.image, expected.colormap, expected.dither, expected.scale);
+                failures++;
+            }
+            else if(r->preview != expected.preview || r->print != expected.print || r->placement != expected.placement
+                    || r->bricks != expected.bricks) {
+                printf("CHANGED %s %s %s %s: preview %08x (was %08x), print %08x (was %08x), placement %08x (was %08x), %u bricks (was %u)\n",
+                       r->image, r->colormap, r->dither, r->scale, r->preview, expected.preview, r->print, expected.print, r->placement,
+                       expected.placement, r->bricks, expected.bricks);
+                failures++;
+            }
+        }
+        else if(sscanf(line, "time %63s %ld", stage, &ns) == 2) {
+            for(int s = 0; s < NUM_STAGES; s++) {
+                if(strcmp(stage, STAGE_NAMES[s])) continue;
+                long limit = ns + ns * THRESHOLD_PCT / 100 + SLACK_NS;
+                bool slow = timing && stage_ns[s] > limit;
+                printf("%s %-10s %9.3f ms (golden %9.3f ms, %+.1f%%)\n", slow ? "SLOWER " : "time   ", stage, stage_ns[s] / 1e6,
+                       ns / 1e6, ns ? (stage_ns[s] - ns) * 100.0 / ns : 0.0);
+                if(slow) failures++;
+            }
+        }
+    }
+    fclose(golden);
+
+    if(checked != num_results) {
+        printf("%d cases ran, %d in the golden file\n", num_results, checked);
+        failures++;
+    }
+    printf("%s: %d cases, %d failures\n", failures ? "FAIL" : "ok", num_results, failures);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 3 || (strcmp(argv[1], "check") && strcmp(argv[1], "update"))) {
+        printf("Usage: %s check|update <golden file> [--no-timing]\n", argv[0]);
+        return 2;
+    }
+    run_all();
+    if(!strcmp(argv[1], "update")) return update(argv[2]);
+    return check(argv[2], !(argc > 3 && !strcmp(argv[3], "--no-timing")));
+}
@@ -0,0 +1,192 @@
+/* File: hal_host.c
+ * =-=-=-=-=-=-=-=-
+ * Host backend of the motion hardware: a virtual gantry driven by the
+ * real stepper driver, running in virtual time.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+#include <stddef.h>
+
+// Project Imports
+#include "gantry.h"
+#include "hal.h"
+#include "kinematics.h"
+
+// State of the virtual gantry
+static struct {
+    int position[NUM_AXES];
+    int dir[NUM_AXES];
+    int step[NUM_AXES];
+    unsigned long steps[NUM_AXES];
+    bool closed[NUM_AXES];
+    bool pending[NUM_AXES];
+    int obstruct_axis;
+    unsigned long obstruct_at;
+    bool obstructed;
+    bool vacuum, holding;
+    unsigned long time_us;
+    unsigned int period_us;
+    hal_handler_t timer_handler;
+    hal_handler_t limit_handlers[NUM_AXES];
+    struct gantry_event picks[GANTRY_MAX_EVENTS], places[GANTRY_MAX_EVENTS];
+    unsigned int num_picks, num_places;
+} gantry;
+
+/* Function: record()
+ * =-=-=-=-=-=-=-=-=-
+ * Appends the current nozzle position to an event list.
+ */
+static void record(struct gantry_event events[], unsigned int *count) {
+    if(*count < GANTRY_MAX_EVENTS) {
+        events[*count].time_us = gantry.time_us;
+        events[*count].x = gantry.position[AXIS_X];
+        events[*count].y = gantry.position[AXIS_Y];
+        events[*count].z = gantry.position[AXIS_Z];
+    }
+    (*count)++;
+}
+
+/* Function: update_nozzle()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * A brick sticks to the nozzle once the vacuum is on at pick height,
+ * and is released when the vacuum switches off.
+ */
+static void update_nozzle(void) {
+    if(gantry.vacuum && !gantry.holding && gantry.position[AXIS_Z] >= machine.pick_z) {
+        gantry.holding = true;
+        record(gantry.picks, &gantry.num_picks);
+    }
+    else if(!gantry.vacuum && gantry.holding) {
+        gantry.holding = false;
+        record(gantry.places, &gantry.num_places);
+    }
+}
+
+/* Function: update_switch()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Closes or opens the limit switch of `axis`, raising an interrupt on
+ * the closing edge (delivered once the running handler returns).
+ */
+static void update_switch(int axis) {
+    bool closed = gantry.position[axis] <= 0 || (gantry.obstructed && gantry.obstruct_axis == axis);
+    if(closed && !gantry.closed[axis] && gantry.limit_handlers[axis]) gantry.pending[axis] = true;
+    gantry.closed[axis] = closed;
+}
+
+void gantry_reset(const int start[NUM_AXES]) {
+    for(int axis = 0; axis < NUM_AXES; axis++) {
+        gantry.position[axis] = start[axis];
+        gantry.steps[axis] = 0;
+        gantry.pending[axis] = false;
+        gantry.closed[axis] = start[axis] <= 0;
+    }
+    gantry.obstruct_axis = -1;
+    gantry.obstructed = false;
+    gantry.vacuum = false;
+    gantry.holding = false;
+    gantry.time_us = 0;
+    gantry.num_picks = 0;
+    gantry.num_places = 0;
+}
+
+void gantry_obstruct(int axis, unsigned long time_us) {
+    gantry.obstruct_axis = axis;
+    gantry.obstruct_at = time_us;
+    gantry.obstructed = false;
+}
+
+int gantry_position(int axis) {
+    return gantry.position[axis];
+}
+
+unsigned long gantry_steps(int axis) {
+    return gantry.steps[axis];
+}
+
+unsigned int gantry_picks(const struct gantry_event **events) {
+    *events = gantry.picks;
+    return gantry.num_picks < GANTRY_MAX_EVENTS ? gantry.num_picks : GANTRY_MAX_EVENTS;
+}
+
+unsigned int gantry_places(const struct gantry_event **events) {
+    *events = gantry.places;
+    return gantry.num_places < GANTRY_MAX_EVENTS ? gantry.num_places : GANTRY_MAX_EVENTS;
+}
+
+// Hardware Abstraction Layer
+
+void hal_steppers_init(void) {
+}
+
+void hal_step_write(int axis, int level) {
+    if(level && !gantry.step[axis]) {
+        gantry.position[axis] += gantry.dir[axis] ? 1 : -1;
+        gantry.steps[axis]++;
+        update_switch(axis);
+        if(axis == AXIS_Z) update_nozzle();
+    }
+    gantry.step[axis] = level;
+}
+
+void hal_dir_write(int axis, int level) {
+    gantry.dir[axis] = level;
+}
+
+void hal_limits_init(const hal_handler_t handlers[]) {
+    for(int axis = 0; axis < NUM_AXES; axis++) {
+        gantry.limit_handlers[axis] = handlers[axis];
+    }
+}
+
+int hal_limit_read(int axis) {
+    return gantry.closed[axis];
+}
+
+void hal_limit_clear(int axis) {
+    gantry.pending[axis] = false;
+}
+
+void hal_vacuum_init(void) {
+}
+
+void hal_vacuum_write(int on) {
+    gantry.vacuum = on;
+    update_nozzle();
+}
+
+void hal_timer_init(unsigned int period_us, hal_handler_t handler) {
+    gantry.period_us = period_us;
+    gantry.timer_handler = handler;
+}
+
+void hal_timer_clear(void) {
+}
+
+unsigned long hal_time_us(void) {
+    return gantry.time_us;
+}
+
+unsigned long hal_cycles(void) {
+    // one cycle per virtual microsecond
+    return gantry.time_us;
+}
+
+void hal_delay_us(unsigned long us) {
+    unsigned long until = gantry.time_us + us;
+    while(gantry.time_us < until) hal_idle();
+}
+
+void hal_idle(void) {
+    // One tick of the stepper timer, then any limit switch interrupts it raised
+    gantry.time_us += gantry.period_us;
+    if(gantry.timer_handler) gantry.timer_handler(0, NULL);
+
+    if(gantry.obstruct_axis >= 0 && !gantry.obstructed && gantry.time_us >= gantry.obstruct_at) {
+        gantry.obstructed = true;
+        update_switch(gantry.obstruct_axis);
+    }
+    for(int axis = 0; axis < NUM_AXES; axis++) {
+        if(gantry.pending[axis]) gantry.limit_handlers[axis](0, NULL);
+    }
+}
@@ -0,0 +1,9 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+/*
+ * Host stand-in for the mango `console.h`: the printer app includes it but
+ * calls nothing from it.
+ */
+
+#endif
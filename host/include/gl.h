@@ -0,0 +1,42 @@
+#ifndef GL_H
+#define GL_H
+
+/*
+ * Host stand-in for the mango `gl.h`: the color type, named colors and
+ * drawing functions used by the printer code (implemented by
+ * `host/gl_host.c`).
+ */
+
+typedef unsigned int color_t;
+
+typedef enum { GL_SINGLEBUFFER = 0, GL_DOUBLEBUFFER = 1 } gl_mode_t;
+
+#define GL_BLACK   0xFF000000
+#define GL_WHITE   0xFFFFFFFF
+#define GL_RED     0xFFFF0000
+#define GL_GREEN   0xFF00FF00
+#define GL_BLUE    0xFF0000FF
+#define GL_CYAN    0xFF00FFFF
+#define GL_MAGENTA 0xFFFF00FF
+#define GL_YELLOW  0xFFFFFF00
+#define GL_AMBER   0xFFFFBF00
+#define GL_ORANGE  0xFFFF3F00
+#define GL_PURPLE  0xFF7F00FF
+#define GL_INDIGO  0xFF000040
+#define GL_CAYENNE 0xFF400000
+#define GL_MOSS    0xFF004000
+#define GL_SILVER  0xFFBBBBBB
+
+void gl_init(int width, int height, gl_mode_t mode);
+int gl_get_width(void);
+int gl_get_height(void);
+int gl_get_char_width(void);
+int gl_get_char_height(void);
+void gl_swap_buffer(void);
+void gl_clear(color_t c);
+void gl_draw_pixel(int x, int y, color_t c);
+void gl_draw_char(int x, int y, char ch, color_t c);
+void gl_draw_string(int x, int y, const char *str, color_t c);
+void gl_draw_rect(int x, int y, int w, int h, color_t c);
+
+#endif
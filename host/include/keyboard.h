@@ -0,0 +1,9 @@
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+/*
+ * Host stand-in for the mango `keyboard.h`: the printer app includes it but
+ * calls nothing from it.
+ */
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef MALLOC_H
+#define MALLOC_H
+
+/*
+ * Host stand-in for the mango `malloc.h`: the host C library provides
+ * malloc and free.
+ */
+
+#include <stdlib.h>
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef MANGO_H
+#define MANGO_H
+
+/*
+ * Host stand-in for the mango `mango.h`: the printer app includes it but
+ * calls nothing from it.
+ */
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef PRINTF_H
+#define PRINTF_H
+
+/*
+ * Host stand-in for the mango `printf.h`: the host C library provides
+ * printf and friends.
+ */
+
+#include <stdio.h>
+
+#endif
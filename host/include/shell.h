@@ -0,0 +1,11 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+/*
+ * Host stand-in for the mango `shell.h`: the type of the input function
+ * the printer app reads keys with.
+ */
+
+typedef char (*input_fn_t)(void);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef STRINGS_H
+#define STRINGS_H
+
+/*
+ * Host stand-in for the mango `strings.h`: the host C library provides
+ * the string functions, except `strlcat` on older C libraries.
+ */
+
+#include <string.h>
+
+static inline size_t mango_strlcat(char *dst, const char *src, size_t dstsize) {
+    size_t dstlen = strnlen(dst, dstsize), srclen = strlen(src);
+    if(dstlen == dstsize) return dstsize + srclen;
+    size_t copy = (srclen < dstsize - dstlen - 1) ? srclen : dstsize - dstlen - 1;
+    memcpy(dst + dstlen, src, copy);
+    dst[dstlen + copy] = '\0';
+    return dstlen + srclen;
+}
+#define strlcat mango_strlcat
+
+#endif
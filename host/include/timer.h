@@ -0,0 +1,29 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+/*
+ * Host stand-in for the mango `timer.h`: ticks come from the host's
+ * monotonic clock (at the mango's 24 MHz), and delays return at once.
+ */
+
+#include <time.h>
+
+static inline unsigned long timer_get_ticks(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)now.tv_sec * 24000000 + now.tv_nsec / 1000 * 24;
+}
+
+static inline void timer_delay_us(int usec) {
+    (void)usec;
+}
+
+static inline void timer_delay_ms(int msec) {
+    (void)msec;
+}
+
+static inline void timer_delay(int sec) {
+    (void)sec;
+}
+
+#endif
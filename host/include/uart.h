@@ -0,0 +1,15 @@
+#ifndef UART_H
+#define UART_H
+
+/*
+ * Host stand-in for the mango `uart.h`: bytes sent over the "UART" go to
+ * stderr, so binary output (the motion trace) stays apart from printf.
+ */
+
+#include <stdio.h>
+
+static inline void uart_send(char ch) {
+    fputc(ch, stderr);
+}
+
+#endif
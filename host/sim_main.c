@@ -0,0 +1,197 @@
+/* File: sim_main.c
+ * =-=-=-=-=-=-=-=-
+ * Runs the printer's motion code against the virtual gantry: homes from
+ * an arbitrary position, prints a test job, and checks every brick was
+ * picked up from its cartridge and placed on its stud, and that the job
+ * took as long as estimated (within 1%). Then checks that a limit switch
+ * closing mid-job stops the machine, and that resuming from the job's
+ * checkpoint places the rest of it. Exits non-zero when anything is off,
+ * so it can gate changes to the motion code.
+ *
+ * With `--trace`, the binary motion trace is written to stderr
+ * (decode it with `pyconversion/trace_decode.py`).
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Library Imports
+#include "gl.h"
+
+// Project Imports
+#include "checkpoint.h"
+#include "colormaps.h"
+#include "feeder_layout.h"
+#include "gantry.h"
+#include "isr_stats.h"
+#include "hal.h"
+#include "kinematics.h"
+#include "motion_program.h"
+#include "placement.h"
+#include "printer_driver.h"
+#include "trace.h"
+
+// Test Job
+#define JOB_SIZE 20
+static const int START[NUM_AXES] = { 31234, 17001, 4321 };
+
+/* Function: make_job()
+ * =-=-=-=-=-=-=-=-=-=-
+ * Builds a JOB_SIZE x JOB_SIZE image already formatted to `color_map`,
+ * with uneven use of the cartridges and some empty (black) studs.
+ */
+static struct img* make_job(const struct printer *color_map) {
+    struct img *job = malloc(sizeof(struct img) + JOB_SIZE * JOB_SIZE * sizeof(unsigned int));
+    job->name = "sim";
+    job->width = JOB_SIZE;
+    job->height = JOB_SIZE;
+    for(int i = 0; i < JOB_SIZE * JOB_SIZE; i++) {
+        int x = i % JOB_SIZE, y = i / JOB_SIZE;
+        if((x + y) % 7 == 0) job->pixels[i] = GL_BLACK;
+        else job->pixels[i] = color_map->list_cartridges[(x * x + 3 * y) % color_map->num_cartridges].color;
+    }
+    return job;
+}
+
+/* Function: check_job()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Compares the bricks the gantry picked up and released with the job,
+ * returning the number of mismatches.
+ */
+static int check_job(const struct placement_list *list) {
+    const struct gantry_event *picks, *places;
+    unsigned int num_picks = gantry_picks(&picks);
+    unsigned int num_places = gantry_places(&places);
+    int errors = 0;
+
+    for(int brick = 0; brick < list->count && brick < num_picks && brick < num_places; brick++) {
+        coordinate pickup = feeder_pickup(list->bricks[brick].cartridge);
+        coordinate place = brick_position(list->bricks[brick].x, list->bricks[brick].y);
+        if(picks[brick].x != pickup.x || picks[brick].y != pickup.y) {
+            printf("  brick %d: picked up at (%d, %d), expected (%d, %d)\n", brick, picks[brick].x, picks[brick].y, pickup.x, pickup.y);
+            errors++;
+        }
+        if(places[brick].x != place.x || places[brick].y != place.y || places[brick].z != machine.place_z) {
+            printf("  brick %d: placed at (%d, %d, %d), expected (%d, %d, %d)\n", brick, places[brick].x, places[brick].y,
+                   places[brick].z, place.x, place.y, machine.place_z);
+            errors++;
+        }
+    }
+    if(num_picks != list->count || num_places != list->count) {
+        printf("  %d bricks in the job, %d picked up, %d placed\n", list->count, num_picks, num_places);
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char *argv[]) {
+    int failures = 0;
+    bool tracing = argc > 1 && strcmp(argv[1], "--trace") == 0;
+    trace_enable(tracing);
+    const struct printer *color_map = &P_MOD_BLUE;
+    struct img *image = make_job(color_map);
+    struct placement_list *job = placement_build(image, color_map);
+
+    gantry_reset(START);
+    configure_steppers();
+    configure_limit_switches();
+    configure_vacuum();
+
+    // Homing from wherever the machine was left
+    if(!home_steppers()) {
+        printf("  homing failed\n");
+        failures++;
+    }
+    unsigned long home_us = hal_time_us();
+    for(int axis = 0; axis < NUM_AXES; axis++) {
+        if(gantry_position(axis) != axis_position(axis)) {
+            printf("  %s homed to %d, driver thinks %d\n", machine.axes[axis].name, gantry_position(axis), axis_position(axis));
+            failures++;
+        }
+    }
+
+    // The whole job (the program homes again first, as a print does)
+    struct motion_program *program = program_compile(job);
+    unsigned long estimate_us = program_estimate(program, NULL);
+    isr_stats_reset(STEPPER_TICK_US);
+    unsigned long job_us = program_replay(program);
+    const volatile struct isr_stats *isr = isr_stats_get();
+    unsigned long ticks = isr->ticks, missed = isr->missed, overruns = isr->overruns;
+    bool isr_ok = ticks == job_us / STEPPER_TICK_US && missed == 0 && overruns == 0;
+    if(!isr_ok) failures++;
+    long error = ((long)estimate_us - (long)job_us) * 1000 / (long)job_us;
+    if(labs(error) > 10) failures++;
+    int errors = check_job(job);
+    failures += errors;
+
+    // A single cycle through `pick_and_place`, as used outside of print jobs
+    const struct gantry_event *picks, *places;
+    unsigned int before = gantry_places(&places);
+    unsigned long cycle_us = hal_time_us();
+    coordinate pickup = feeder_pickup(1), place = brick_position(JOB_SIZE - 1, 0);
+    pick_and_place(JOB_SIZE - 1, 0, pickup);
+    cycle_us = hal_time_us() - cycle_us;
+    unsigned int picked = gantry_picks(&picks), placed = gantry_places(&places);
+    bool cycle_ok = placed == before + 1 && picked == placed && picks[picked - 1].x == pickup.x && picks[picked - 1].y == pickup.y
+                    && places[placed - 1].x == place.x && places[placed - 1].y == place.y;
+    if(!cycle_ok) failures++;
+
+    // A switch closing halfway through must stop the machine and the program
+    gantry_reset(START);
+    gantry_obstruct(AXIS_Y, job_us / 2);
+    checkpoint_start(&checkpoint, 0, 0, 0, job);
+    unsigned int pc = 0;
+    int result;
+    while((result = program_run(program, &pc)) >= 0) {
+        checkpoint_placed(&checkpoint, job, result, axis_position(AXIS_X), axis_position(AXIS_Y), axis_position(AXIS_Z));
+    }
+    unsigned long stopped_us = hal_time_us();
+    unsigned long steps = gantry_steps(AXIS_X) + gantry_steps(AXIS_Y) + gantry_steps(AXIS_Z);
+    hal_delay_us(1000000);
+    unsigned long drift = gantry_steps(AXIS_X) + gantry_steps(AXIS_Y) + gantry_steps(AXIS_Z) - steps;
+    if(result != PROGRAM_FAULT || drift != 0) {
+        printf("  obstruction: program returned %d, %lu steps after stopping\n", result, drift);
+        failures++;
+    }
+
+    // Clearing the obstruction and resuming from the checkpoint places the rest of the job
+    unsigned int stopped_after = gantry_places(&places);
+    const int stopped[NUM_AXES] = { gantry_position(AXIS_X), gantry_position(AXIS_Y), gantry_position(AXIS_Z) };
+    gantry_reset(stopped);
+    struct motion_program *resume = program_compile_range(job, checkpoint.next, job->count);
+    pc = 0;
+    while((result = program_run(resume, &pc)) >= 0) {
+        checkpoint_placed(&checkpoint, job, result, axis_position(AXIS_X), axis_position(AXIS_Y), axis_position(AXIS_Z));
+    }
+    unsigned int resumed = gantry_places(&places);
+    bool resume_ok = result == PROGRAM_END && checkpoint.next == job->count && stopped_after + resumed >= job->count;
+    for(int brick = 0; resume_ok && brick < resumed; brick++) {
+        coordinate place = brick_position(job->bricks[job->count - resumed + brick].x, job->bricks[job->count - resumed + brick].y);
+        if(places[brick].x != place.x || places[brick].y != place.y) resume_ok = false;
+    }
+    if(!resume_ok) failures++;
+    program_free(resume);
+    trace_flush();
+
+    printf("\n=== Virtual gantry ===\n");
+    printf("homing:       %lu.%03lu s\n", home_us / 1000000, home_us / 1000 % 1000);
+    printf("job:          %d bricks in %lu.%03lu s (%lu ms per brick)\n", program->bricks, job_us / 1000000,
+           job_us / 1000 % 1000, program->bricks ? job_us / 1000 / program->bricks : 0);
+    printf("estimate:     %lu.%03lu s (%s%ld.%ld%% off)\n", estimate_us / 1000000, estimate_us / 1000 % 1000, error < 0 ? "-" : "+",
+           labs(error) / 10, labs(error) % 10);
+    printf("stepper isr:  %s (%lu ticks, %lu missed, %lu overruns)\n", isr_ok ? "ok" : "FAIL", ticks, missed, overruns);
+    printf("placements:   %s (%d errors)\n", errors ? "FAIL" : "ok", errors);
+    printf("single cycle: %s (%lu ms)\n", cycle_ok ? "ok" : "FAIL", cycle_us / 1000);
+    printf("obstruction:  %s (stopped at %lu.%03lu s, after %d bricks)\n", drift == 0 ? "ok" : "FAIL",
+           stopped_us / 1000000, stopped_us / 1000 % 1000, stopped_after);
+    printf("resume:       %s (%d bricks from brick %d)\n", resume_ok ? "ok" : "FAIL", resumed, job->count - resumed);
+    if(tracing) printf("trace:        %u records dropped\n", trace_dropped());
+
+    program_free(program);
+    placement_free(job);
+    free(image);
+    return failures ? 1 : 0;
+}
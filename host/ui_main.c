@@ -0,0 +1,265 @@
+/* File: ui_main.c
+ * =-=-=-=-=-=-=-=
+ * Runs the printer app headless on the host, as a frame time and
+ * overdraw benchmark of its pages: `printer_init` reads its keys from a
+ * script instead of the keyboard, the screen is the in-memory
+ * framebuffer of `gl_host.c`, and prints run on the virtual gantry.
+ *
+ *     ./host/ui [--snapshots DIR] [--print-limit SECONDS] [--record] <script>
+ *     ./host/ui [--print-limit SECONDS] [--record] --replay <capture>
+ *
+ * A script is a list of keys separated by whitespace (`#` starts a
+ * comment): `enter`, `esc`, `up`, `down`, `left` and `right`, or any
+ * single character (the hidden keys of `printer.c`). `snap` writes the
+ * screen to DIR as a PPM file instead of pressing a key, and `key*N`
+ * presses a key N times. The script has to quit the app (`esc right
+ * enter` from the menu). Prints are stopped by a limit switch after
+ * SECONDS of virtual time (0 prints the whole job), so a script can
+ * visit the printing page without waiting for the job.
+ *
+ * `--replay` reads the keys instead from an operator session dumped over
+ * UART (`input_log.c`), and `--record` dumps the session of this run the
+ * same way when it ends. Two runs of the same keys show the same frames:
+ * compare the digest printed after the rows (the timings overlay aside).
+ *
+ * Prints one CSV row per page (after whatever the app prints itself):
+ *
+ *     page,frames,ms_per_frame,max_ms,draws_per_frame,pixels_per_frame,overdraw
+ *
+ * where `overdraw` is the pixels written per pixel of the screen.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Library Imports
+#include "gl.h"
+
+// Project Imports
+#include "gantry.h"
+#include "gl_host.h"
+#include "hal.h"
+#include "input_log.h"
+#include "kinematics.h"
+#include "printer.h"
+#include "printer_driver.h"
+#include "trace.h"
+
+// Constants
+#define MAX_KEYS 4096
+#define KEY_SNAP -1
+#define DEFAULT_PRINT_LIMIT_S 120
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+static const int START[NUM_AXES] = { 31234, 17001, 4321 };
+
+// Key names of the script (the key codes `printer.c` reads)
+static const struct { const char *name; int key; } KEY_NAMES[] = {
+    { "enter", 0x0a }, { "esc", 0x95 }, { "up", 0xaa }, { "down", 0xab }, { "left", 0xac }, { "right", 0xad }, { "snap", KEY_SNAP },
+};
+#define NUM_KEY_NAMES (sizeof(KEY_NAMES) / sizeof(KEY_NAMES[0]))
+
+// Pages of the app, indexed by the mode of `printer.c` (MODE_TITLE is -2)
+extern int mode;
+static const char *const PAGE_NAMES[] = { "title", "quit", "menu", "preview", "printing" };
+#define NUM_PAGES (sizeof(PAGE_NAMES) / sizeof(PAGE_NAMES[0]))
+
+// Contains the frames drawn on one page: their count, total and worst time, and total draw calls and pixels
+struct page_stats {
+    unsigned long frames;
+    long ns, max_ns;
+    unsigned long draw_calls, pixels;
+};
+
+static struct page_stats pages[NUM_PAGES];
+static unsigned int digest = FNV_OFFSET;
+static int script[MAX_KEYS];
+static unsigned int script_len, script_pos;
+static unsigned int session[INPUT_LOG_EVENTS];
+static unsigned int session_len;
+static const char *snapshot_dir = ".";
+static unsigned long print_limit_us;
+static unsigned int snapshots;
+static input_fn_t source;
+static bool recording;
+
+/* Function: load_script()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Reads a script into the list of keys, returning -1 (with a message)
+ * if it cannot be read.
+ */
+static int load_script(const char *path) {
+    FILE *file = fopen(path, "r");
+    if(!file) {
+        printf("Cannot read %s\n", path);
+        return -1;
+    }
+
+    char line[256];
+    while(fgets(line, sizeof(line), file)) {
+        char *comment = strchr(line, '#');
+        if(comment) *comment = '\0';
+        for(char *token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+            // Key, and how many times it is pressed
+            int count = 1;
+            char *times = strchr(token, '*');
+            if(times) {
+                *times = '\0';
+                count = atoi(times + 1);
+            }
+            int key = (unsigned char)token[0];
+            if(strlen(token) > 1) {
+                unsigned int k = 0;
+                while(k < NUM_KEY_NAMES && strcmp(token, KEY_NAMES[k].name)) k++;
+                if(k == NUM_KEY_NAMES) {
+                    printf("Unknown key '%s' in %s\n", token, path);
+                    fclose(file);
+                    return -1;
+                }
+                key = KEY_NAMES[k].key;
+            }
+            for(int i = 0; i < count && script_len < MAX_KEYS; i++) script[script_len++] = key;
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+/* Function: load_session()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Reads the events of the last session dumped in a UART capture,
+ * returning -1 (with a message) if there is none.
+ */
+static int load_session(const char *path) {
+    FILE *file = fopen(path, "r");
+    if(!file) {
+        printf("Cannot read %s\n", path);
+        return -1;
+    }
+
+    char line[256];
+    bool inside = false, found = false;
+    unsigned int ms, key;
+    while(fgets(line, sizeof(line), file)) {
+        if(!strncmp(line, "INPUT ", strlen("INPUT "))) {
+            session_len = 0;
+            inside = found = true;
+        }
+        else if(!strncmp(line, "END INPUT", strlen("END INPUT"))) inside = false;
+        else if(inside && sscanf(line, "%u %x", &ms, &key) == 2 && session_len < INPUT_LOG_EVENTS) {
+            session[session_len++] = INPUT_EVENT(ms, key);
+        }
+    }
+    fclose(file);
+    if(!found) printf("No input session in %s\n", path);
+    return found ? 0 : -1;
+}
+
+/* Function: count_frame()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Adds a frame to the stats of the page the app is on.
+ */
+static void count_frame(const struct gl_frame_stats *frame) {
+    int page = mode + 2;
+    if(page < 0 || page >= (int)NUM_PAGES) return;
+    struct page_stats *stats = &pages[page];
+    stats->frames++;
+    stats->ns += frame->ns;
+    if(frame->ns > stats->max_ns) stats->max_ns = frame->ns;
+    stats->draw_calls += frame->draw_calls;
+    stats->pixels += frame->pixels;
+    digest = (digest ^ frame->checksum) * FNV_PRIME;
+}
+
+/* Function: report()
+ * =-=-=-=-=-=-=-=-=-
+ * Prints the CSV row of every page visited.
+ */
+static void report(void) {
+    double screen = (double)gl_get_width() * gl_get_height();
+    printf("page,frames,ms_per_frame,max_ms,draws_per_frame,pixels_per_frame,overdraw\n");
+    for(unsigned int p = 0; p < NUM_PAGES; p++) {
+        const struct page_stats *stats = &pages[p];
+        if(!stats->frames) continue;
+        printf("%s,%lu,%.3f,%.3f,%.0f,%.0f,%.2f\n", PAGE_NAMES[p], stats->frames, stats->ns / 1e6 / stats->frames,
+               stats->max_ns / 1e6, (double)stats->draw_calls / stats->frames, (double)stats->pixels / stats->frames,
+               stats->pixels / screen / stats->frames);
+    }
+    printf("frames digest %08x\n", digest);
+    if(recording) input_dump();
+}
+
+/* Function: end_of_input()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Input function once the keys run out: the app did not quit by itself,
+ * so reports and stops the run.
+ */
+static char end_of_input(void) {
+    report();
+    printf("The keys ran out before the app quit\n");
+    exit(1);
+}
+
+/* Function: script_read()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Input function of a script: takes any snapshots due, then returns
+ * the next key.
+ */
+static char script_read(void) {
+    while(script_pos < script_len && script[script_pos] == KEY_SNAP) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/ui_%02u_%s.ppm", snapshot_dir, snapshots++, PAGE_NAMES[mode + 2]);
+        if(gl_host_snapshot(path)) printf("Cannot write %s\n", path);
+        script_pos++;
+    }
+    if(script_pos == script_len) return end_of_input();
+    return (char)script[script_pos++];
+}
+
+/* Function: app_read()
+ * =-=-=-=-=-=-=-=-=-=-
+ * Input function of the app: reads the next key, then arms the limit
+ * switch that stops a print started by it.
+ */
+static char app_read(void) {
+    char key = source();
+    if(print_limit_us) gantry_obstruct(AXIS_Y, hal_time_us() + print_limit_us);
+    return key;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL, *replay = NULL;
+    unsigned long limit_s = DEFAULT_PRINT_LIMIT_S;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--snapshots") && i + 1 < argc) snapshot_dir = argv[++i];
+        else if(!strcmp(argv[i], "--print-limit") && i + 1 < argc) limit_s = strtoul(argv[++i], NULL, 10);
+        else if(!strcmp(argv[i], "--replay") && i + 1 < argc) replay = argv[++i];
+        else if(!strcmp(argv[i], "--record")) recording = true;
+        else path = argv[i];
+    }
+    if(!path == !replay) {
+        printf("Usage: %s [--snapshots DIR] [--print-limit SECONDS] [--record] <script>\n", argv[0]);
+        printf("       %s [--print-limit SECONDS] [--record] --replay <capture>\n", argv[0]);
+        return 2;
+    }
+    if(path ? load_script(path) : load_session(replay)) return 2;
+    print_limit_us = limit_s * 1000000;
+
+    // The machine as `davinci.c` brings it up (without the motion trace on the "UART")
+    trace_enable(false);
+    gantry_reset(START);
+    configure_steppers();
+    configure_limit_switches();
+    configure_vacuum();
+
+    // Keys from the script or the session (replayed without waiting: time on the host is virtual), recorded if asked
+    source = path ? script_read : input_replay(session, session_len, false, end_of_input);
+    gl_host_on_frame(count_frame);
+    printer_init(recording ? input_record(app_read) : app_read);
+    printer_run();
+    report();
+    return 0;
+}
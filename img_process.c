@@ -20,6 +20,10 @@
 #include "img_process.h"
 #include "bitmaps.h"
 #include "colormaps.h"
+#include "heap.h"
+#include "inventory.h"
+#include "lab_tables.h"
+#include "perf.h"
 
 // Constants
 #define R_SHIFT 16
@@ -28,6 +32,71 @@
 #define COLOR 0xff
 #define NONE -1
 #define BACKGROUND_REMOVAL true
+#define PERCEPTUAL_MATCHING true // !! IMPORTANT -> (matches colors in Lab instead of raw sRGB; false for the old matches)
+#define MATCHING_SPACE (PERCEPTUAL_MATCHING ? SPACE_LAB : SPACE_RGB)
+#define GLOBAL_ASSIGNMENT true // !! IMPORTANT -> (matches printed jobs all at once within the capacities; false to take the nearest cartridge pixel by pixel)
+
+// Lab: offset of a and b (signed) in their channels, the flag of a cached Lab color (above the channels, so a cached
+// black is not mistaken for an empty entry), and the entries of the cache of cartridge colors
+#define LAB_AB_OFFSET 128
+#define LAB_CACHED 0x01000000
+#define LAB_CACHE_SIZE 64
+
+// SWAR constants for 16-bit lanes: the top bit of each lane, the bits under it, a 1 in each lane, and the key penalty
+// of an empty cartridge (its distance bits all set, above any real distance of at most 3 * COLOR)
+#define LANE_TOP 0x8000800080008000UL
+#define LANE_LOW 0x7fff7fff7fff7fffUL
+#define LANE_ONES 0x0001000100010001UL
+#define KEY_INDEX_BITS 5
+#define KEY_EMPTY (0x3ffUL << KEY_INDEX_BITS)
+
+// Palette selection: bits kept per channel in the histogram of a job's colors, the most swaps tried, and the
+// distance to no cartridge at all
+#define SELECT_BIN_BITS 4
+#define SELECT_BINS (1 << (3 * SELECT_BIN_BITS))
+#define SELECT_MAX_SWAPS 32
+#define SELECT_NO_BIN 0xffff
+#define SELECT_FAR 0xffff
+
+// Contains a bin of the histogram of a job's colors: its pixels and the sums of their channels, and the picked
+// candidate cartridge closest to it (and the distances to the closest two picked)
+struct select_bin {
+    unsigned int count, red, green, blue;
+    unsigned int nearest;
+    unsigned int nearest_distance, second_distance;
+};
+
+// Global assignment: the distance of leaving a pixel unmatched (the farthest possible color), no node before on a
+// path, no path at all, and the multiplier hashing colors into bins (Knuth's)
+#define ASSIGN_UNMATCHED (3 * COLOR)
+#define ASSIGN_NONE -1
+#define ASSIGN_FAR 0x7fffffff
+#define ASSIGN_HASH 2654435761u
+#define ASSIGN_MAX_NODES (PALETTE_MAX_CARTRIDGES + 1)
+
+// Contains the flow of a global assignment: the pixels of each bin sent to each node (the cartridges, then the
+// unmatched pixels), the distance of each bin to each node, and the cheapest move of one pixel already placed from
+// each node to each other node (and the bin it is a pixel of)
+struct assign_flow {
+    unsigned int num_nodes, num_bins;
+    unsigned int *flows;
+    const unsigned short *distances;
+    int moves[ASSIGN_MAX_NODES][ASSIGN_MAX_NODES];
+    unsigned int move_bins[ASSIGN_MAX_NODES][ASSIGN_MAX_NODES];
+};
+
+// Dithering: channels per pixel, Floyd-Steinberg errors kept in 16ths of a level, and Bayer offsets spanning
+// BAYER_SPREAD levels (about the gap between neighboring colors of the small color maps)
+#define NUM_CHANNELS 3
+#define FS_SHIFT 4
+#define BAYER_SPREAD 64
+static const unsigned char BAYER[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+const char* const DITHER_NAMES[] = { "OFF", "FS", "BAYER" };
 
 /* Function: display_image()
  * =-=-=-=-=-=-=-=-=-=-=-=-=
@@ -111,10 +180,11 @@ struct img* center_crop_image(const struct img *input, unsigned int width_cut, u
  * spanning inputted `scaled_width` x `scaled_height`
  */
 struct img* down_scale_image(const struct img *input, unsigned int scaled_width, unsigned int scaled_height) {
-    // Return original image if attempted to scale down to higher resolution
+    // Return a copy of the original image if attempted to scale down to higher resolution (callers free the result)
     if(scaled_width >= input->width || scaled_height >= input->height) {
-        return (struct img*)input;
+        return crop_image(input, 0, 0, input->width, input->height);
     }
+    PERF_BEGIN(PERF_DOWN_SCALE);
 
     // Initialize original width/heights
     int crop_width = input->width;
@@ -137,8 +207,10 @@ struct img* down_scale_image(const struct img *input, unsigned int scaled_width,
     }
 
     // If image is too small for integer division errors to become negligible, center crop to common multiples found above
+    struct img *cropped = NULL;
     if(input->width < 1000 || input->height < 1000) {
-        input = center_crop_image(input, input->width - crop_width, input->height - crop_height);
+        cropped = center_crop_image(input, input->width - crop_width, input->height - crop_height);
+        input = cropped;
     }
 
     // Initialize result variables
@@ -157,7 +229,9 @@ struct img* down_scale_image(const struct img *input, unsigned int scaled_width,
         unsigned int target_pixel = input->pixels[(i % scaled_width) * x_pixel_ratio + (x_pixel_ratio / 2) + ((input->width * (i / scaled_width) * y_pixel_ratio + (y_pixel_ratio / 2)))];
         result->pixels[i] = target_pixel;
     }
+    free(cropped);
     
+    PERF_END(PERF_DOWN_SCALE);
     return result;
 }
 
@@ -166,7 +240,30 @@ struct img* down_scale_image(const struct img *input, unsigned int scaled_width,
  * Formats image to match inputted color map. Utilizes `palette_convert()`
  * to convert pixels to closest match from inputted color map.
  */
-struct img* format_image(const struct img *input, struct printer color_map, bool printing_state) {
+struct img* format_image(const struct img *input, const struct printer *color_map, bool printing_state) {
+    return format_image_dithered(input, color_map, printing_state, DITHER_NONE);
+}
+
+/* Function: clamp_channel()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Clamps a color channel pushed out of range by dithering.
+ */
+static inline int clamp_channel(int value) {
+    if(value < 0) return 0;
+    if(value > COLOR) return COLOR;
+    return value;
+}
+
+/* Function: format_image_dithered()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Formats image to match inputted color map, dithering as it goes. The
+ * image is converted row by row: Floyd-Steinberg errors (in 16ths of a
+ * level) go into a buffer for the current row and one for the row below,
+ * which take turns, so memory only grows with the width.
+ */
+struct img* format_image_dithered(const struct img *input, const struct printer *color_map, bool printing_state, enum dither_mode dither) {
+    PERF_BEGIN(PERF_FORMAT);
+
     // Initialize result variables
     unsigned int input_size = input->height * input->width;
     struct img* result = malloc(sizeof(struct img) + (input_size * sizeof(unsigned int)));
@@ -174,35 +271,100 @@ struct img* format_image(const struct img *input, struct printer color_map, bool
     result->height = input->height;
     result->width = input->width;
 
-    // Declare copy of cartridge values if not in printing mode (doesn't remove pixels during print)
-    unsigned int cap_copy[color_map.num_cartridges];
-    
-    // Copy cartridge values to copy delcared above
-    for(int i = 0; i < color_map.num_cartridges; i++) {
-        cap_copy[i] = color_map.list_cartridges[i].capacity;
-    } 
-
-    // Convert the pixels to new colors using `palette_convert()`
-    for(int i = 0; i < input_size; i++) {
-
-        // !!! DELETE IF BROKEN - BETA FEATURE
-        if(BACKGROUND_REMOVAL) {
-            if(are_neighbors_matching(input, input->pixels[i], GL_BLACK, i)) {
-                result->pixels[i] = GL_BLACK;
+    // Errors of the current row and the row below, per channel, with a pixel of padding on either side
+    unsigned int row_size = (input->width + 2) * NUM_CHANNELS;
+    short *errors = NULL, *curr = NULL, *next = NULL;
+    if(dither == DITHER_FLOYD_STEINBERG) {
+        errors = malloc(2 * row_size * sizeof(short));
+        memset(errors, 0, 2 * row_size * sizeof(short));
+        curr = errors;
+        next = errors + row_size;
+    }
+
+    // Pixels matched all at once when printing (their colors to match, and where they go in the result)
+    unsigned int num_targets = 0, *targets = NULL, *target_pixels = NULL;
+    int *matches = NULL;
+    if(GLOBAL_ASSIGNMENT && printing_state && dither != DITHER_FLOYD_STEINBERG) {
+        targets = malloc(input_size * sizeof(unsigned int));
+        target_pixels = malloc(input_size * sizeof(unsigned int));
+        matches = malloc(input_size * sizeof(int));
+    }
+
+    // Convert the pixels to new colors (the same match as `palette_convert()`, with the color map packed once, so
+    // a job only uses up the palette's snapshot of the bricks available)
+    struct palette palette;
+    palette_pack(&palette, color_map, MATCHING_SPACE);
+    for(int y = 0; y < input->height; y++) {
+        for(int x = 0; x < input->width; x++) {
+            unsigned int i = y * input->width + x;
+            unsigned int pixel = input->pixels[i];
+
+            // !!! DELETE IF BROKEN - BETA FEATURE
+            if(BACKGROUND_REMOVAL) {
+                if(are_neighbors_matching(input, pixel, GL_BLACK, i)) {
+                    result->pixels[i] = GL_BLACK;
+                    continue;
+                }
+            }
+            // !!! DELETE IF BROKEN - BETA FEATURE
+
+            // Color to match: the pixel plus the errors diffused onto it, or its offset in the Bayer pattern
+            int channels[NUM_CHANNELS] = { (pixel >> R_SHIFT) & COLOR, (pixel >> G_SHIFT) & COLOR, (pixel >> B_SHIFT) & COLOR };
+            unsigned int target = pixel;
+            if(dither != DITHER_NONE) {
+                int offset = (dither == DITHER_BAYER) ? (2 * BAYER[y % 4][x % 4] - 15) * BAYER_SPREAD / 32 : 0;
+                for(int c = 0; c < NUM_CHANNELS; c++) {
+                    if(dither == DITHER_FLOYD_STEINBERG) channels[c] += (curr[(x + 1) * NUM_CHANNELS + c] + (1 << (FS_SHIFT - 1))) >> FS_SHIFT;
+                    channels[c] = clamp_channel(channels[c] + offset);
+                }
+                target = (channels[0] << R_SHIFT) | (channels[1] << G_SHIFT) | (channels[2] << B_SHIFT);
+            }
+            if(targets) {
+                targets[num_targets] = target;
+                target_pixels[num_targets++] = i;
                 continue;
             }
+
+            int index = palette_nearest(&palette, target, printing_state);
+            result->pixels[i] = (index < 0) ? pixel : color_map->list_cartridges[index].color;
+
+            // Diffuse what the match is off by: 7/16 to the right, 3/16 below left, 5/16 below and 1/16 below right
+            if(dither == DITHER_FLOYD_STEINBERG && index >= 0) {
+                unsigned int match = result->pixels[i];
+                int matched[NUM_CHANNELS] = { (match >> R_SHIFT) & COLOR, (match >> G_SHIFT) & COLOR, (match >> B_SHIFT) & COLOR };
+                for(int c = 0; c < NUM_CHANNELS; c++) {
+                    int error = channels[c] - matched[c];
+                    curr[(x + 2) * NUM_CHANNELS + c] += 7 * error;
+                    next[x * NUM_CHANNELS + c] += 3 * error;
+                    next[(x + 1) * NUM_CHANNELS + c] += 5 * error;
+                    next[(x + 2) * NUM_CHANNELS + c] += error;
+                }
+            }
         }
-        // !!! DELETE IF BROKEN - BETA FEATURE
 
-        unsigned int converted_pixel = palette_convert(input->pixels[i], color_map, printing_state);
-        result->pixels[i] = converted_pixel;
+        // The row below becomes the current row, and the one after it starts without errors
+        if(errors) {
+            short *done = curr;
+            curr = next;
+            next = done;
+            memset(next, 0, row_size * sizeof(short));
+        }
     }
+    free(errors);
 
-    // Return original color values to normal (so values only change when directly calling palette_convert)
-    for(int i = 0; i < color_map.num_cartridges; i++) {
-        color_map.list_cartridges[i].capacity = cap_copy[i];
+    // Match the pixels held back all at once
+    if(targets) {
+        palette_assign(&palette, targets, num_targets, matches);
+        for(unsigned int t = 0; t < num_targets; t++) {
+            unsigned int i = target_pixels[t];
+            result->pixels[i] = (matches[t] < 0) ? input->pixels[i] : color_map->list_cartridges[matches[t]].color;
+        }
+        free(targets);
+        free(target_pixels);
+        free(matches);
     }
 
+    PERF_END(PERF_FORMAT);
     return result;
 }
 
@@ -227,55 +389,635 @@ struct img* crop_image(const struct img *input, unsigned int x_start, unsigned i
     return result;
 }
 
+/* Function: down_scale_crop_image()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Downscales input image to `scale` x `scale` and crops the region
+ * starting at {`x_start`,`y_start`} of `width` x `height` from it.
+ */
+struct img* down_scale_crop_image(const struct img *input, unsigned int scale, unsigned int x_start, unsigned int y_start, unsigned int width, unsigned int height) {
+    struct img *scaled = down_scale_image(input, scale, scale);
+    if(x_start == 0 && y_start == 0 && width == scaled->width && height == scaled->height) return scaled;
+
+    // Free the downscaled image once the region is copied out of it
+    struct img *result = crop_image((const struct img*)scaled, x_start, y_start, width, height);
+    free(scaled);
+    return result;
+}
+
+/* Function: lane_abs_diff()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Returns |a - b| in every 16-bit lane of a and b (lanes of at most
+ * 15 bits). Biasing a by the lane's top bit keeps borrows inside the
+ * lane; the lanes that went negative are then negated (two's complement
+ * within their low 15 bits).
+ */
+static inline uint64_t lane_abs_diff(uint64_t a, uint64_t b) {
+    uint64_t diff = (a | LANE_TOP) - b;
+    uint64_t negative = (~diff & LANE_TOP) >> 15;
+    return ((diff & LANE_LOW) ^ ((negative << 15) - negative)) + negative;
+}
+
+/* Function: lane_min()
+ * =-=-=-=-=-=-=-=-=-=-
+ * Returns the smaller of a and b in every 16-bit lane (lanes of at most
+ * 15 bits).
+ */
+static inline uint64_t lane_min(uint64_t a, uint64_t b) {
+    uint64_t a_smaller = (~((a | LANE_TOP) - b) & LANE_TOP) >> 15;
+    uint64_t mask = (a_smaller << 16) - a_smaller;
+    return (a & mask) | (b & ~mask);
+}
+
+/* Function: set_empty()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Rules a cartridge of a palette in or out of matching, following the
+ * bricks left in it.
+ */
+static void set_empty(struct palette *palette, unsigned int index) {
+    unsigned int shift = (index % PALETTE_LANES) * 16;
+    uint64_t *key = &palette->key[index / PALETTE_LANES];
+    if(palette->spare[index] > 0) *key &= ~(KEY_EMPTY << shift);
+    else *key |= KEY_EMPTY << shift;
+}
+
+/* Function: color_to_lab()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Converts a color to Lab through the generated tables: each channel to
+ * linear light, the three to X, Y and Z over the white point (which
+ * stay at most LAB_LINEAR_ONE, as the rows of the matrix add up to one),
+ * then the cube root of each into L, a and b.
+ */
+unsigned int color_to_lab(unsigned int color) {
+    unsigned int linear[NUM_CHANNELS] = {
+        LAB_LINEAR[(color >> R_SHIFT) & COLOR], LAB_LINEAR[(color >> G_SHIFT) & COLOR], LAB_LINEAR[(color >> B_SHIFT) & COLOR]
+    };
+    int f[NUM_CHANNELS];
+    for(int row = 0; row < NUM_CHANNELS; row++) {
+        unsigned int xyz = LAB_XYZ[row][0] * linear[0] + LAB_XYZ[row][1] * linear[1] + LAB_XYZ[row][2] * linear[2];
+        f[row] = LAB_F[(xyz + (1 << (LAB_XYZ_BITS - 1))) >> LAB_XYZ_BITS];
+    }
+
+    // L = 116 f(Y) - 16, a = 500 (f(X) - f(Y)) and b = 200 (f(Y) - f(Z)), rounded off the table's fraction bits
+    int half = 1 << (LAB_F_BITS - 1);
+    int l = clamp_channel((116 * f[1] - (16 << LAB_F_BITS) + half) >> LAB_F_BITS);
+    int a = clamp_channel(((500 * (f[0] - f[1]) + half) >> LAB_F_BITS) + LAB_AB_OFFSET);
+    int b = clamp_channel(((200 * (f[1] - f[2]) + half) >> LAB_F_BITS) + LAB_AB_OFFSET);
+    return (l << R_SHIFT) | (a << G_SHIFT) | (b << B_SHIFT);
+}
+
+/* Function: cartridge_lab()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns the Lab color of a cartridge, from a cache of the converted
+ * cartridge colors kept here (so the color maps stay read only). The
+ * cache is keyed by color, so it never goes stale, and two colors
+ * sharing an entry only cost a conversion.
+ */
+static unsigned int cartridge_lab(const struct cartridge *cartridge) {
+    static struct {
+        unsigned int color, lab;
+    } cache[LAB_CACHE_SIZE];
+    unsigned int slot = ((cartridge->color ^ (cartridge->color >> 15)) * ASSIGN_HASH) % LAB_CACHE_SIZE;
+    if(!(cache[slot].lab & LAB_CACHED) || cache[slot].color != cartridge->color) {
+        cache[slot].color = cartridge->color;
+        cache[slot].lab = color_to_lab(cartridge->color) | LAB_CACHED;
+    }
+    return cache[slot].lab & ~LAB_CACHED;
+}
+
+/* Function: palette_pack()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Packs a color map into 16-bit lanes, once per image instead of
+ * unpacking every cartridge for every pixel. Lanes past the last
+ * cartridge are packed as empty cartridges.
+ */
+void palette_pack(struct palette *palette, const struct printer *color_map, enum color_space space) {
+    palette->color_map = color_map;
+    palette->space = space;
+    palette->last_pixel = 0;
+    palette->last_lab = (space == SPACE_LAB) ? color_to_lab(0) : 0;
+    palette->num_cartridges = color_map->num_cartridges;
+    if(palette->num_cartridges > PALETTE_MAX_CARTRIDGES) palette->num_cartridges = PALETTE_MAX_CARTRIDGES;
+    palette->num_words = (palette->num_cartridges + PALETTE_LANES - 1) / PALETTE_LANES;
+
+    for(unsigned int word = 0; word < palette->num_words; word++) {
+        palette->red[word] = palette->green[word] = palette->blue[word] = palette->key[word] = 0;
+        for(unsigned int lane = 0; lane < PALETTE_LANES; lane++) {
+            unsigned int i = word * PALETTE_LANES + lane, shift = lane * 16;
+            palette->key[word] |= (uint64_t)(i | (i < palette->num_cartridges ? 0 : KEY_EMPTY)) << shift;
+            if(i >= palette->num_cartridges) continue;
+            const struct cartridge *cartridge = &color_map->list_cartridges[i];
+            palette->spare[i] = inventory_available(cartridge);
+            unsigned int color = (space == SPACE_LAB) ? cartridge_lab(cartridge) : cartridge->color;
+            palette->red[word] |= (uint64_t)((color >> R_SHIFT) & COLOR) << shift;
+            palette->green[word] |= (uint64_t)((color >> G_SHIFT) & COLOR) << shift;
+            palette->blue[word] |= (uint64_t)((color >> B_SHIFT) & COLOR) << shift;
+        }
+    }
+    for(unsigned int i = 0; i < palette->num_cartridges; i++) set_empty(palette, i);
+}
+
+/* Function: palette_key()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Matches a color (already in the palette's color space) against four
+ * cartridges per step: the L1 distance of every lane, shifted over the
+ * lane's key (its index, or the empty penalty), so the smallest key is
+ * the closest non-empty cartridge with the lowest index. Keys are
+ * reduced lane-wise across words, then across the four lanes of the
+ * last word. Returns the smallest key.
+ */
+static unsigned int palette_key(const struct palette *palette, unsigned int color) {
+    uint64_t red = ((color >> R_SHIFT) & COLOR) * LANE_ONES;
+    uint64_t green = ((color >> G_SHIFT) & COLOR) * LANE_ONES;
+    uint64_t blue = ((color >> B_SHIFT) & COLOR) * LANE_ONES;
+
+    uint64_t best = LANE_LOW;
+    for(unsigned int word = 0; word < palette->num_words; word++) {
+        uint64_t distance = lane_abs_diff(red, palette->red[word]) + lane_abs_diff(green, palette->green[word])
+                            + lane_abs_diff(blue, palette->blue[word]);
+        best = lane_min(best, (distance << KEY_INDEX_BITS) | palette->key[word]);
+    }
+    best = lane_min(best, best >> 32);
+    return lane_min(best, best >> 16) & 0xffff;
+}
+
+/* Function: key_match()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Splits a key into the distance and the index of its cartridge. Only
+ * a cartridge closer than the farthest possible color matches.
+ */
+static inline int key_match(unsigned int key, unsigned int *distance) {
+    *distance = key >> KEY_INDEX_BITS;
+    return (*distance < 3 * COLOR) ? (int)(key & ((1 << KEY_INDEX_BITS) - 1)) : -1;
+}
+
+/* Function: palette_match()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Matches a pixel without taking a brick. In Lab, the pixel is
+ * converted first (unless it is the same as the last one, or there is
+ * nothing to match it against), and the lanes hold L, a and b in place
+ * of red, green and blue.
+ */
+int palette_match(struct palette *palette, unsigned int pixel, unsigned int *distance) {
+    if(palette->space == SPACE_LAB && palette->num_words) {
+        if(pixel != palette->last_pixel) {
+            palette->last_pixel = pixel;
+            palette->last_lab = color_to_lab(pixel);
+        }
+        pixel = palette->last_lab;
+    }
+    return key_match(palette_key(palette, pixel), distance);
+}
+
+/* Function: palette_nearest()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Matches a pixel, taking a brick from the palette's snapshot of the
+ * match if printing.
+ */
+int palette_nearest(struct palette *palette, unsigned int pixel, bool printing_state) {
+    unsigned int distance;
+    int index = palette_match(palette, pixel, &distance);
+
+    // If image is printing, each LEGO piece matched uses up one of the bricks left (none when nothing matched)
+    if(index >= 0 && printing_state) {
+        palette->spare[index]--;
+        set_empty(palette, index);
+    }
+    return index;
+}
+
+/* Function: color_distance()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns the sum of the absolute differences of the channels of two
+ * colors (the distance `palette_nearest` matches by).
+ */
+static inline unsigned int color_distance(unsigned int a, unsigned int b) {
+    unsigned int distance = 0;
+    for(int shift = B_SHIFT; shift <= R_SHIFT; shift += G_SHIFT - B_SHIFT) {
+        int diff = (int)((a >> shift) & COLOR) - (int)((b >> shift) & COLOR);
+        distance += (diff < 0) ? -diff : diff;
+    }
+    return distance;
+}
+
+/* Function: assign_moves()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Offers the moves of a pixel of a bin out of a node, keeping the ones
+ * cheaper than the node's cheapest so far.
+ */
+static void assign_moves(struct assign_flow *flow, unsigned int bin, unsigned int node) {
+    const unsigned short *distance = &flow->distances[bin * flow->num_nodes];
+    for(unsigned int to = 0; to < flow->num_nodes; to++) {
+        int cost = (int)distance[to] - (int)distance[node];
+        if(to == node || cost >= flow->moves[node][to]) continue;
+        flow->moves[node][to] = cost;
+        flow->move_bins[node][to] = bin;
+    }
+}
+
+/* Function: assign_push()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Sends pixels of a bin to a node (or takes them back, for a negative
+ * amount), keeping the cheapest moves out of the node up to date. When
+ * a bin runs out of pixels in a node and gave one of its moves, the
+ * node's moves are found again over the bins left in it.
+ */
+static void assign_push(struct assign_flow *flow, unsigned int bin, unsigned int node, int amount) {
+    unsigned int *pixels = &flow->flows[bin * flow->num_nodes + node];
+    *pixels += amount;
+    if(amount > 0) {
+        assign_moves(flow, bin, node);
+        return;
+    }
+    if(*pixels) return;
+
+    bool stale = false;
+    for(unsigned int to = 0; to < flow->num_nodes; to++) stale |= (flow->moves[node][to] != ASSIGN_FAR && flow->move_bins[node][to] == bin);
+    if(!stale) return;
+    for(unsigned int to = 0; to < flow->num_nodes; to++) flow->moves[node][to] = ASSIGN_FAR;
+    for(unsigned int h = 0; h < flow->num_bins; h++) {
+        if(flow->flows[h * flow->num_nodes + node]) assign_moves(flow, h, node);
+    }
+}
+
+/* Function: palette_assign()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Min-cost flow from the distinct colors (bins) of the pixels to the
+ * cartridges, plus a node for the pixels left unmatched (never full), by
+ * successive shortest paths. Each bin is added in turn: straight to its
+ * nearest node if that has room (no path can beat it, or the flow so far
+ * would not be the cheapest), otherwise along the cheapest path to a
+ * node with room, moving pixels of other bins out of the full nodes on
+ * the way. The graph of those moves has only the nodes for vertices
+ * (the cheapest move between each two, kept as the flow changes), so a
+ * path costs a Bellman-Ford over at most ASSIGN_MAX_NODES nodes, however
+ * many pixels the job has. Each bin's pixels are then handed out to its
+ * nodes in proportion, interleaved in raster order.
+ */
+void palette_assign(struct palette *palette, const unsigned int *pixels, unsigned int count, int *matches) {
+    // Nodes: the cartridges (with the room left in them), then the pixels left unmatched (the moves between them
+    // kept off the stack)
+    static struct assign_flow flow;
+    unsigned int num_nodes = palette->num_cartridges + 1, unmatched = palette->num_cartridges;
+    unsigned int spare[ASSIGN_MAX_NODES], colors[PALETTE_MAX_CARTRIDGES];
+    for(unsigned int c = 0; c < palette->num_cartridges; c++) {
+        const struct cartridge *cartridge = &palette->color_map->list_cartridges[c];
+        spare[c] = palette->spare[c];
+        colors[c] = (palette->space == SPACE_LAB) ? cartridge_lab(cartridge) : cartridge->color;
+    }
+    spare[unmatched] = count;
+
+    // Bins: the distinct colors of the pixels (hashed, the bin of each pixel kept in `matches` until the end)
+    unsigned int table_size = 16, num_bins = 0;
+    while(table_size < 2 * count) table_size *= 2;
+    int *table = malloc(table_size * sizeof(int));
+    unsigned int *bin_pixels = malloc((count + 1) * sizeof(unsigned int));
+    unsigned int *bin_counts = malloc((count + 1) * sizeof(unsigned int));
+    memset(table, 0xff, table_size * sizeof(int));
+    for(unsigned int t = 0; t < count; t++) {
+        unsigned int slot = ((pixels[t] ^ (pixels[t] >> 15)) * ASSIGN_HASH) & (table_size - 1);
+        while(table[slot] >= 0 && bin_pixels[table[slot]] != pixels[t]) slot = (slot + 1) & (table_size - 1);
+        if(table[slot] < 0) {
+            table[slot] = num_bins;
+            bin_pixels[num_bins] = pixels[t];
+            bin_counts[num_bins++] = 0;
+        }
+        bin_counts[table[slot]]++;
+        matches[t] = table[slot];
+    }
+    free(table);
+
+    // Distance of each bin to each node, and no pixels sent anywhere yet
+    unsigned short *distances = malloc((num_bins * num_nodes + 1) * sizeof(unsigned short));
+    for(unsigned int h = 0; h < num_bins; h++) {
+        unsigned int color = (palette->space == SPACE_LAB) ? color_to_lab(bin_pixels[h]) : bin_pixels[h];
+        for(unsigned int c = 0; c < palette->num_cartridges; c++) distances[h * num_nodes + c] = color_distance(color, colors[c]);
+        distances[h * num_nodes + unmatched] = ASSIGN_UNMATCHED;
+    }
+    flow.num_nodes = num_nodes;
+    flow.num_bins = num_bins;
+    flow.distances = distances;
+    flow.flows = malloc((num_bins * num_nodes + 1) * sizeof(unsigned int));
+    memset(flow.flows, 0, (num_bins * num_nodes + 1) * sizeof(unsigned int));
+    for(unsigned int a = 0; a < num_nodes; a++) {
+        for(unsigned int b = 0; b < num_nodes; b++) flow.moves[a][b] = ASSIGN_FAR;
+    }
+
+    // Add the bins one by one, keeping the flow the cheapest for the bins added so far
+    int dist[ASSIGN_MAX_NODES], via_node[ASSIGN_MAX_NODES];
+    unsigned int via_bin[ASSIGN_MAX_NODES];
+    for(unsigned int h = 0; h < num_bins; h++) {
+        const unsigned short *distance = &distances[h * num_nodes];
+        unsigned int supply = bin_counts[h];
+        while(supply) {
+            // Straight to the nearest node if it has room
+            unsigned int nearest = 0;
+            for(unsigned int c = 1; c < num_nodes; c++) if(distance[c] < distance[nearest]) nearest = c;
+            if(spare[nearest]) {
+                unsigned int push = (supply < spare[nearest]) ? supply : spare[nearest];
+                assign_push(&flow, h, nearest, push);
+                spare[nearest] -= push;
+                supply -= push;
+                continue;
+            }
+
+            // Cheapest paths from the bin to every node (no negative cycles, as the flow so far is the cheapest)
+            for(unsigned int c = 0; c < num_nodes; c++) {
+                dist[c] = distance[c];
+                via_node[c] = ASSIGN_NONE;
+            }
+            for(unsigned int round = 1; round < num_nodes; round++) {
+                bool changed = false;
+                for(unsigned int a = 0; a < num_nodes; a++) {
+                    for(unsigned int b = 0; b < num_nodes; b++) {
+                        if(flow.moves[a][b] == ASSIGN_FAR || dist[a] + flow.moves[a][b] >= dist[b]) continue;
+                        dist[b] = dist[a] + flow.moves[a][b];
+                        via_node[b] = a;
+                        via_bin[b] = flow.move_bins[a][b];
+                        changed = true;
+                    }
+                }
+                if(!changed) break;
+            }
+
+            // Push as many pixels as the path to the cheapest node with room allows (the unmatched node always has)
+            unsigned int end = unmatched;
+            for(unsigned int c = 0; c < num_nodes; c++) if(spare[c] && dist[c] < dist[end]) end = c;
+            unsigned int push = (supply < spare[end]) ? supply : spare[end];
+            for(int node = end; via_node[node] != ASSIGN_NONE; node = via_node[node]) {
+                unsigned int movable = flow.flows[via_bin[node] * num_nodes + via_node[node]];
+                if(movable < push) push = movable;
+            }
+            int node = end;
+            for(; via_node[node] != ASSIGN_NONE; node = via_node[node]) {
+                unsigned int bin = via_bin[node];
+                assign_push(&flow, bin, node, push);
+                assign_push(&flow, bin, via_node[node], -(int)push);
+            }
+            assign_push(&flow, h, node, push);
+            spare[end] -= push;
+            supply -= push;
+        }
+    }
+    free(distances);
+
+    // Hand each bin's pixels out to its nodes in proportion (smooth weighted round robin, so no part of the
+    // image takes all of one)
+    int *credits = malloc((num_bins * num_nodes + 1) * sizeof(int));
+    memset(credits, 0, (num_bins * num_nodes + 1) * sizeof(int));
+    for(unsigned int t = 0; t < count; t++) {
+        unsigned int h = matches[t];
+        int *credit = &credits[h * num_nodes];
+        unsigned int pick = 0;
+        for(unsigned int c = 0; c < num_nodes; c++) {
+            credit[c] += flow.flows[h * num_nodes + c];
+            if(credit[c] > credit[pick]) pick = c;
+        }
+        credit[pick] -= bin_counts[h];
+        matches[t] = (pick == unmatched) ? -1 : (int)pick;
+    }
+    free(credits);
+    free(flow.flows);
+    free(bin_pixels);
+    free(bin_counts);
+
+    // Take the bricks
+    for(unsigned int c = 0; c < palette->num_cartridges; c++) {
+        palette->spare[c] = spare[c];
+        set_empty(palette, c);
+    }
+}
+
 /* Function: palette_convert()
  * =-=-=-=-=-=-=-=-=-=-=-=-=-=
  * Converts input pixel to closest color from input color map.
  */
-unsigned int palette_convert(unsigned int pixel, struct printer color_map, bool printing_state) {
-
-
-
-    // Initialize variables
-    unsigned int min_distance = 3 * COLOR;
-    unsigned int candidate = pixel;
-    unsigned int temp_distance = 0;
-    int candidate_index = 0;
-
-    // Initialize color values
-    unsigned int red = (pixel >> R_SHIFT) & COLOR;
-    unsigned int green = (pixel >> G_SHIFT) & COLOR;
-    unsigned int blue = (pixel >> B_SHIFT) & COLOR;
-
-    // Cycle through possible colors in color map to find best matching color
-    for(int i = 0; i < color_map.num_cartridges; i++) {
-        // Initialize RGB values of current color
-        unsigned int CMAP_blue = (color_map.list_cartridges[i].color >> B_SHIFT) & COLOR;
-        unsigned int CMAP_green = (color_map.list_cartridges[i].color >> G_SHIFT) & COLOR;
-        unsigned int CMAP_red = (color_map.list_cartridges[i].color >> R_SHIFT) & COLOR;
-
-        // Find total distance of input pixel to current color
-        if(red > CMAP_red) temp_distance += red - CMAP_red;
-        else temp_distance += CMAP_red - red;
-        if(green > CMAP_green) temp_distance += green - CMAP_green;
-        else temp_distance += CMAP_green - green;
-        if(blue > CMAP_blue) temp_distance += blue - CMAP_blue;
-        else temp_distance += CMAP_blue - blue;
-
-        // If new minimum distance found, set to return pixel
-        if(temp_distance < min_distance && color_map.list_cartridges[i].capacity > 0) {
-            min_distance = temp_distance;
-            candidate = color_map.list_cartridges[i].color; 
-            candidate_index = i;
+unsigned int palette_convert(unsigned int pixel, const struct printer *color_map) {
+    struct palette palette;
+    palette_pack(&palette, color_map, MATCHING_SPACE);
+    int index = palette_nearest(&palette, pixel, false);
+    return (index < 0) ? pixel : color_map->list_cartridges[index].color;
+}
+
+/* Function: rank_before()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Returns true if score a ranks strictly before score b.
+ */
+static bool rank_before(const struct colormap_score *a, const struct colormap_score *b) {
+    if(!a->shortfall != !b->shortfall) return !a->shortfall;
+    if(!a->matched != !b->matched) return a->matched;
+    return a->error < b->error;
+}
+
+/* Function: colormap_rank()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Packs every color map once, then walks the job's pixels a single
+ * time, matching each against all of them (converted to the matching
+ * space once for all of them). A pixel is a brick unless it
+ * is background or matches a black cartridge (as `placement_build`
+ * counts them). The scores are then insertion sorted.
+ */
+void colormap_rank(const struct img *job, const struct printer *const printers[], unsigned int num_printers, struct colormap_ranking *ranking) {
+    if(num_printers > RANK_MAX_PRINTERS) num_printers = RANK_MAX_PRINTERS;
+    struct palette palettes[RANK_MAX_PRINTERS];
+    ranking->num_scores = num_printers;
+    for(unsigned int p = 0; p < num_printers; p++) {
+        palette_pack(&palettes[p], printers[p], MATCHING_SPACE);
+        memset(&ranking->scores[p], 0, sizeof(struct colormap_score));
+        ranking->scores[p].printer = p;
+    }
+
+    // Match every pixel against every color map
+    unsigned int last_pixel = 0, color = (MATCHING_SPACE == SPACE_LAB) ? color_to_lab(0) : 0;
+    for(int i = 0; i < job->width * job->height; i++) {
+        unsigned int pixel = job->pixels[i];
+        if(BACKGROUND_REMOVAL && are_neighbors_matching(job, pixel, GL_BLACK, i)) continue;
+        if(pixel != last_pixel) {
+            last_pixel = pixel;
+            color = (MATCHING_SPACE == SPACE_LAB) ? color_to_lab(pixel) : pixel;
+        }
+        for(unsigned int p = 0; p < num_printers; p++) {
+            struct colormap_score *score = &ranking->scores[p];
+            unsigned int distance;
+            int index = key_match(palette_key(&palettes[p], color), &distance);
+            if(index < 0) {
+                // Unmatched pixels keep their color, a brick no cartridge gives
+                if(pixel != GL_BLACK) {
+                    score->bricks++;
+                    score->shortfall++;
+                }
+                continue;
+            }
+            score->matched++;
+            score->error += distance;
+            if(printers[p]->list_cartridges[index].color == GL_BLACK) continue;
+            score->bricks++;
+            score->demand[index]++;
         }
+    }
 
-        // Reset temp distance
-        temp_distance = 0;
+    // Bricks past those available in each cartridge
+    for(unsigned int p = 0; p < num_printers; p++) {
+        struct colormap_score *score = &ranking->scores[p];
+        for(unsigned int c = 0; c < palettes[p].num_cartridges; c++) {
+            unsigned int available = palettes[p].spare[c];
+            if(score->demand[c] > available) score->shortfall += score->demand[c] - available;
+        }
     }
 
-    // If image is printing, after each LEGO piece printed, remove one from cartridge capacity
-    if(color_map.num_cartridges && printing_state) (color_map.list_cartridges[candidate_index].capacity)--;
+    // Rank the color maps covering the job first, then those falling short, then those matching nothing, each by error
+    for(unsigned int p = 1; p < num_printers; p++) {
+        struct colormap_score score = ranking->scores[p];
+        unsigned int q = p;
+        for(; q > 0 && rank_before(&score, &ranking->scores[q - 1]); q--) ranking->scores[q] = ranking->scores[q - 1];
+        ranking->scores[q] = score;
+    }
+}
 
-    return candidate;
+/* Function: select_assign()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Finds the closest two picked candidates of every bin (from the table
+ * of the distances of each bin to each candidate), returning the total
+ * distance of the pixels to their closest pick.
+ */
+static unsigned long select_assign(struct select_bin *bins, unsigned int num_bins, const unsigned short *distances, const bool *picked, unsigned int num_candidates) {
+    unsigned long cost = 0;
+    for(unsigned int h = 0; h < num_bins; h++) {
+        struct select_bin *bin = &bins[h];
+        bin->nearest_distance = bin->second_distance = SELECT_FAR;
+        for(unsigned int c = 0; c < num_candidates; c++) {
+            if(!picked[c]) continue;
+            unsigned int distance = distances[h * num_candidates + c];
+            if(distance < bin->nearest_distance) {
+                bin->second_distance = bin->nearest_distance;
+                bin->nearest_distance = distance;
+                bin->nearest = c;
+            }
+            else if(distance < bin->second_distance) bin->second_distance = distance;
+        }
+        cost += (unsigned long)bin->count * bin->nearest_distance;
+    }
+    return cost;
+}
+
+/* Function: palette_select()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Bins the job's pixels (so the work grows with the colors of the job,
+ * not its size), then runs PAM over the bins: the picks are built up
+ * greedily, each the candidate cutting the total distance the most, then
+ * improved by the best swap of a pick for a candidate until no swap
+ * helps (or SELECT_MAX_SWAPS). The distances of the bins to the
+ * candidates are worked out once, and with the closest two picks of
+ * every bin kept, a swap is costed in one pass over the bins.
+ */
+void palette_select(const struct img *job, const struct printer *inventory, unsigned int k, struct printer *selected) {
+    // Candidates: the cartridges of the inventory with bricks available, in the matching space
+    unsigned int num_candidates = 0, candidates[PALETTE_MAX_CARTRIDGES], colors[PALETTE_MAX_CARTRIDGES];
+    bool picked[PALETTE_MAX_CARTRIDGES];
+    for(unsigned int c = 0; c < inventory->num_cartridges && c < PALETTE_MAX_CARTRIDGES; c++) {
+        const struct cartridge *cartridge = &inventory->list_cartridges[c];
+        if(!inventory_available(cartridge)) continue;
+        picked[num_candidates] = false;
+        colors[num_candidates] = (MATCHING_SPACE == SPACE_LAB) ? cartridge_lab(cartridge) : cartridge->color;
+        candidates[num_candidates++] = c;
+    }
+    if(k > num_candidates) k = num_candidates;
+
+    // Histogram of the job's colors (the background removed), each bin then taken as the mean of its pixels
+    unsigned int num_pixels = job->width * job->height, num_bins = 0;
+    unsigned short *bin_of = malloc(SELECT_BINS * sizeof(unsigned short));
+    struct select_bin *bins = malloc(((num_pixels < SELECT_BINS) ? num_pixels + 1 : SELECT_BINS) * sizeof(struct select_bin));
+    memset(bin_of, 0xff, SELECT_BINS * sizeof(unsigned short));
+    for(int i = 0; i < num_pixels; i++) {
+        unsigned int pixel = job->pixels[i];
+        if(BACKGROUND_REMOVAL && are_neighbors_matching(job, pixel, GL_BLACK, i)) continue;
+        unsigned int red = (pixel >> R_SHIFT) & COLOR, green = (pixel >> G_SHIFT) & COLOR, blue = (pixel >> B_SHIFT) & COLOR;
+        unsigned int drop = 8 - SELECT_BIN_BITS;
+        unsigned int key = ((red >> drop) << (2 * SELECT_BIN_BITS)) | ((green >> drop) << SELECT_BIN_BITS) | (blue >> drop);
+        if(bin_of[key] == SELECT_NO_BIN) {
+            bin_of[key] = num_bins;
+            memset(&bins[num_bins++], 0, sizeof(struct select_bin));
+        }
+        struct select_bin *bin = &bins[bin_of[key]];
+        bin->count++;
+        bin->red += red;
+        bin->green += green;
+        bin->blue += blue;
+    }
+    free(bin_of);
+
+    // Distance of each bin's mean to each candidate, looked up by every step after
+    unsigned short *distances = malloc((num_bins * num_candidates + 1) * sizeof(unsigned short));
+    for(unsigned int h = 0; h < num_bins; h++) {
+        struct select_bin *bin = &bins[h];
+        unsigned int half = bin->count / 2;
+        unsigned int mean = (((bin->red + half) / bin->count) << R_SHIFT) | (((bin->green + half) / bin->count) << G_SHIFT)
+                            | (((bin->blue + half) / bin->count) << B_SHIFT);
+        if(MATCHING_SPACE == SPACE_LAB) mean = color_to_lab(mean);
+        for(unsigned int c = 0; c < num_candidates; c++) distances[h * num_candidates + c] = color_distance(mean, colors[c]);
+    }
+
+    // Build: add the candidate cutting the total distance the most, k times
+    select_assign(bins, num_bins, distances, picked, num_candidates);
+    for(unsigned int step = 0; step < k; step++) {
+        unsigned long best_cost = (unsigned long)-1;
+        unsigned int best = 0;
+        for(unsigned int c = 0; c < num_candidates; c++) {
+            if(picked[c]) continue;
+            unsigned long cost = 0;
+            for(unsigned int h = 0; h < num_bins; h++) {
+                unsigned int distance = distances[h * num_candidates + c];
+                cost += (unsigned long)bins[h].count * ((distance < bins[h].nearest_distance) ? distance : bins[h].nearest_distance);
+            }
+            if(cost < best_cost) {
+                best_cost = cost;
+                best = c;
+            }
+        }
+        picked[best] = true;
+        select_assign(bins, num_bins, distances, picked, num_candidates);
+    }
+
+    // Swap: replace a pick by a candidate while that cuts the total distance (bins of the pick fall back to their
+    // second closest pick, or to the candidate)
+    for(unsigned int swap = 0; k && swap < SELECT_MAX_SWAPS; swap++) {
+        long best_delta = 0;
+        unsigned int best_out = 0, best_in = 0;
+        for(unsigned int out = 0; out < num_candidates; out++) {
+            if(!picked[out]) continue;
+            for(unsigned int in = 0; in < num_candidates; in++) {
+                if(picked[in]) continue;
+                long delta = 0;
+                for(unsigned int h = 0; h < num_bins; h++) {
+                    const struct select_bin *bin = &bins[h];
+                    unsigned int distance = distances[h * num_candidates + in];
+                    unsigned int kept = (bin->nearest == out) ? bin->second_distance : bin->nearest_distance;
+                    delta += (long)bin->count * ((long)((distance < kept) ? distance : kept) - (long)bin->nearest_distance);
+                }
+                if(delta < best_delta) {
+                    best_delta = delta;
+                    best_out = out;
+                    best_in = in;
+                }
+            }
+        }
+        if(!best_delta) break;
+        picked[best_out] = false;
+        picked[best_in] = true;
+        select_assign(bins, num_bins, distances, picked, num_candidates);
+    }
+    free(distances);
+    free(bins);
+
+    // Copy the picks, in inventory order (their bricks still come out of the inventory's cartridges)
+    selected->num_cartridges = 0;
+    for(unsigned int c = 0; c < num_candidates; c++) {
+        if(!picked[c]) continue;
+        struct cartridge *pick = &inventory->list_cartridges[candidates[c]];
+        struct cartridge *copy = &selected->list_cartridges[selected->num_cartridges++];
+        *copy = *pick;
+        copy->reserved = 0;
+        copy->stock = pick->stock ? pick->stock : pick;
+    }
 }
 
 // !!! DELETE IF BROKEN - BETA FEATURE
@@ -11,6 +11,7 @@
 
 // Standard Library Imports
 #include <stdbool.h>
+#include <stdint.h>
 
 // Project Imports
 #include "bitmaps.h"
@@ -20,6 +21,53 @@
 extern const struct img* BITMAP_LIST[];
 extern const unsigned int BITMAP_LIST_SIZE;
 
+// Dithering modes of `format_image_dithered`, and their names (at most 5 characters, for the preview menu)
+enum dither_mode { DITHER_NONE, DITHER_FLOYD_STEINBERG, DITHER_BAYER, NUM_DITHER_MODES };
+extern const char* const DITHER_NAMES[];
+
+// Color spaces cartridges are matched in: raw sRGB, or (perceptually) CIE Lab
+enum color_space { SPACE_RGB, SPACE_LAB };
+
+// Packed palettes: four cartridges per 64-bit word (16-bit lanes), at most 32 cartridges (the index fits in 5 bits)
+#define PALETTE_LANES 4
+#define PALETTE_MAX_CARTRIDGES 32
+#define PALETTE_WORDS (PALETTE_MAX_CARTRIDGES / PALETTE_LANES)
+
+// Contains the cartridges of a color map in structure-of-arrays form, for matching several cartridges per 64-bit
+// operation: each channel of each cartridge in its own lane, and per lane the cartridge's index (plus a penalty that
+// rules the cartridge out while it is empty). In Lab, the channels are L, a and b, and the last pixel converted is
+// kept, as neighboring pixels are mostly the same color. The bricks each cartridge had available when packed are
+// a snapshot the palette takes its matches from, so matching never changes the inventory.
+struct palette {
+    const struct printer *color_map;
+    enum color_space space;
+    unsigned int num_cartridges, num_words;
+    unsigned int last_pixel, last_lab;
+    unsigned int spare[PALETTE_MAX_CARTRIDGES];
+    uint64_t red[PALETTE_WORDS], green[PALETTE_WORDS], blue[PALETTE_WORDS];
+    uint64_t key[PALETTE_WORDS];
+};
+
+// Colormap ranking: at most this many color maps are scored at once
+#define RANK_MAX_PRINTERS 8
+
+// Contains how well a color map fits a job: the total distance of the pixels to their matches (in the matching
+// space), the pixels matched and bricks they make, the bricks each cartridge gives, and the bricks its capacities
+// cannot cover (past the bricks available in a cartridge, or with no cartridge at all)
+struct colormap_score {
+    unsigned int printer;
+    unsigned long error;
+    unsigned int matched, bricks, shortfall;
+    unsigned int demand[PALETTE_MAX_CARTRIDGES];
+};
+
+// Contains the scores of the color maps ranked, best first: those that cover the job, then those falling short,
+// then those matching nothing, each by error
+struct colormap_ranking {
+    unsigned int num_scores;
+    struct colormap_score scores[RANK_MAX_PRINTERS];
+};
+
 /*
  * `display_image`
  *
@@ -72,24 +120,89 @@ struct img* center_crop_image(const struct img *input, unsigned int width_cut, u
  * @param pixel_width   the number of horizontal pixels on scaled image
  * @param pixel_height  the number of vertical pixels on scaled image
  * 
- * @return              the downscaled image as type struct img*
+ * @return              the downscaled image as type struct img* (always a new image, freed by the caller)
  */ 
 struct img* down_scale_image(const struct img *input, unsigned int pixel_width, unsigned int pixel_height);
 
+/*
+ * `palette_pack`
+ *
+ * Packs the colors of a color map into a palette, with a snapshot of the bricks available in each cartridge
+ * (`inventory_available`). Cartridges past PALETTE_MAX_CARTRIDGES are left out.
+ *
+ * @param palette     the palette to fill
+ * @param color_map   the color map to pack (kept, for the colors of the matches)
+ * @param space       the color space to match in (SPACE_LAB converts and caches the Lab colors of the cartridges)
+ */
+void palette_pack(struct palette *palette, const struct printer *color_map, enum color_space space);
+
+/*
+ * `palette_nearest`
+ *
+ * Finds the non-empty cartridge closest to a pixel (by the sum of the absolute differences of its channels
+ * in the palette's color space, the first one on a tie), without branching on the cartridges.
+ *
+ * @param palette         the packed color map
+ * @param pixel           the pixel to match
+ * @param printing_state  true to take a brick from the palette's snapshot of the matching cartridge
+ *
+ * @return                the index of the cartridge, or -1 if none is closer than the farthest possible color
+ *                        (in sRGB; in Lab, every cartridge is)
+ */
+int palette_nearest(struct palette *palette, unsigned int pixel, bool printing_state);
+
+/*
+ * `palette_match`
+ *
+ * Same as `palette_nearest` without taking a brick, but also gives how far the pixel is from its match.
+ *
+ * @param palette         the packed color map
+ * @param pixel           the pixel to match
+ * @param distance        where to store the distance to the match (in the palette's color space)
+ *
+ * @return                the index of the cartridge, or -1 as `palette_nearest`
+ */
+int palette_match(struct palette *palette, unsigned int pixel, unsigned int *distance);
+
+/*
+ * `color_to_lab`
+ *
+ * Converts a color to CIE Lab in integer math, from the tables of `lab_tables.c`.
+ *
+ * @param color   the color to convert
+ *
+ * @return        the color in Lab, packed as a color: L (0 to 100) in place of red, and a and b (offset by 128,
+ *                clamped to 0 to 255) in place of green and blue
+ */
+unsigned int color_to_lab(unsigned int color);
+
+/*
+ * `palette_assign`
+ *
+ * Matches many pixels at once within the capacities of the palette's color map, taking the bricks: the
+ * assignment of pixels to cartridges with the least total distance that no cartridge runs out in, so a
+ * job short of a color gives up its closest matches evenly instead of wherever the cartridge ran out.
+ * Solved as a min-cost flow from the distinct colors of the pixels to the cartridges.
+ *
+ * @param palette     the packed color map (the bricks are taken from its snapshot, as `palette_nearest` does)
+ * @param pixels      the pixels to match
+ * @param count       the number of pixels
+ * @param matches     where to store the index of each pixel's cartridge (-1 past the capacities of all of them)
+ */
+void palette_assign(struct palette *palette, const unsigned int *pixels, unsigned int count, int *matches);
+
 /*
  * `palette_convert`
  *
  * Finds the closest matching color to an input pixel unsigned int on an inputted color map
- * and returns that color.
+ * and returns that color (perceptually, in Lab, unless PERCEPTUAL_MATCHING is off in `img_process.c`).
  *
  * @param pixel           the original pixel compared to the color map
- * @param color_map       the color map containing valid pixels
- * @param printing_state  the bool determining whether or not to remove the color from the color map
- *                        (if the printer is printing, the pixel is subtracted from the capacity)
+ * @param color_map       the color map containing valid pixels (cartridges with no bricks available are skipped)
  * 
  * @return                the closest matching pixel within color map as type unsigned int
  */ 
-unsigned int palette_convert(unsigned int pixel, struct printer color_map, bool printing_state);
+unsigned int palette_convert(unsigned int pixel, const struct printer *color_map);
 
 /*
  * `format_image`
@@ -99,12 +212,62 @@ unsigned int palette_convert(unsigned int pixel, struct printer color_map, bool
  *
  * @param input           the image to be formatted to an inputted color map
  * @param color_map       the color map containing valid pixels 
- * @param printing_state  the bool determining whether or not to remove the color from the color map
- *                        (if the printer is printing, the pixel is subtracted from the capacity)
+ * @param printing_state  the bool determining whether or not the image is a job to print
+ *                        (if so, each pixel uses up a brick of the bricks available, so the job fits in them)
  * 
  * @return                the formatted image as type struct img*
  */ 
-struct img* format_image(const struct img *input, struct printer color_map, bool printing_state);
+struct img* format_image(const struct img *input, const struct printer *color_map, bool printing_state);
+
+/*
+ * `format_image_dithered`
+ *
+ * Same as `format_image`, but spreads the difference between each pixel and its match over its neighbors,
+ * so areas between two colors of the color map come out as a mix of them instead of bands. Floyd-Steinberg
+ * diffuses each pixel's error to the pixels right of and below it (keeping two rows of errors); Bayer adds a
+ * fixed 4x4 pattern of offsets before matching. All in integer math. When printing, the pixels are matched
+ * all at once by `palette_assign` (unless GLOBAL_ASSIGNMENT is off in `img_process.c`, or with Floyd-Steinberg,
+ * which needs each match before the next pixel).
+ *
+ * @param input           the image to be formatted to an inputted color map
+ * @param color_map       the color map containing valid pixels
+ * @param printing_state  the bool determining whether or not the image is a job to print
+ *                        (if so, each pixel uses up a brick of the bricks available, so the job fits in them)
+ * @param dither          the dithering mode (DITHER_NONE matches every pixel as `format_image` does)
+ *
+ * @return                the formatted image as type struct img*
+ */
+struct img* format_image_dithered(const struct img *input, const struct printer *color_map, bool printing_state, enum dither_mode dither);
+
+/*
+ * `colormap_rank`
+ *
+ * Scores every color map of a list against a job in a single pass over its pixels: each pixel is matched
+ * against all of them as `format_image` matches it (no dithering, the background removed), adding up the
+ * error and the demand on each cartridge. The color maps are then ranked, best first.
+ *
+ * @param job            the image to print (downscaled and cropped to the job)
+ * @param printers       the color maps to score
+ * @param num_printers   the number of color maps (at most RANK_MAX_PRINTERS are scored)
+ * @param ranking        where to store the ranked scores
+ */
+void colormap_rank(const struct img *job, const struct printer *const printers[], unsigned int num_printers, struct colormap_ranking *ranking);
+
+/*
+ * `palette_select`
+ *
+ * Picks the k cartridges of an inventory that best fit a job (those the feeder has room for), by k-medoids
+ * over a histogram of the job's colors: the cartridges minimizing the total distance of the pixels to their
+ * closest pick (in the matching space). Cartridges with no bricks available are never picked. All in integer
+ * math.
+ *
+ * @param job          the image to print (downscaled and cropped to the job)
+ * @param inventory    the color map to pick from (at most PALETTE_MAX_CARTRIDGES cartridges are considered)
+ * @param k            the number of cartridges to pick
+ * @param selected     the color map filled in with copies of the picks, in inventory order, drawing on the
+ *                     inventory's stock (its cartridge list needs room for k)
+ */
+void palette_select(const struct img *job, const struct printer *inventory, unsigned int k, struct printer *selected);
 
 /*
  * `crop_image`
@@ -122,6 +285,23 @@ struct img* format_image(const struct img *input, struct printer color_map, bool
  */ 
 struct img* crop_image(const struct img *input, unsigned int x_start, unsigned int y_start, unsigned int width, unsigned int height);
 
+/*
+ * `down_scale_crop_image`
+ *
+ * Downscales an inputted image to `scale` x `scale`, then crops the result as `crop_image` does
+ * (skipping the crop when it would keep the whole image).
+ *
+ * @param input      the image to be downscaled and cropped
+ * @param scale      the width and height of the downscaled image
+ * @param x_start    the starting x position of the crop
+ * @param y_start    the starting y position of the crop
+ * @param width      the width of cropped image
+ * @param height     the height of cropped image
+ * 
+ * @return           the downscaled and cropped image as type struct img*
+ */ 
+struct img* down_scale_crop_image(const struct img *input, unsigned int scale, unsigned int x_start, unsigned int y_start, unsigned int width, unsigned int height);
+
 /*
  * `are_neighbors_matching`
  *
@@ -0,0 +1,98 @@
+/* File: input_log.c
+ * =-=-=-=-=-=-=-=-=
+ * Recorder and replayer of operator key presses.
+ */
+
+// Library Imports
+#include "printf.h"
+
+// Project Imports
+#include "hal.h"
+#include "input_log.h"
+
+// Recording: the input function recorded, the events so far, and when the last key came in
+static struct {
+    input_fn_t read_fn;
+    unsigned int events[INPUT_LOG_EVENTS];
+    unsigned int count;
+    unsigned int dropped;
+    unsigned long last_us;
+} recording;
+
+// Replay: the session, the next event of it and when the last one was due, and what to read once it is over
+static struct {
+    const unsigned int *events;
+    unsigned int count;
+    unsigned int next;
+    bool paced;
+    unsigned long due_us;
+    input_fn_t then;
+} replay;
+
+/* Function: recorded_read()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Reads a key from the recorded input function and appends it to the
+ * recording.
+ */
+static char recorded_read(void) {
+    char key = recording.read_fn();
+    unsigned long now = hal_time_us();
+    unsigned long ms = (now - recording.last_us) / 1000;
+    if(ms > INPUT_MS_MAX) ms = INPUT_MS_MAX;
+    // Keep the leftover microseconds, so rounding never adds up over a session
+    recording.last_us = now - (now - recording.last_us) % 1000;
+
+    if(recording.count < INPUT_LOG_EVENTS) recording.events[recording.count++] = INPUT_EVENT(ms, key);
+    else recording.dropped++;
+    return key;
+}
+
+input_fn_t input_record(input_fn_t read_fn) {
+    recording.read_fn = read_fn;
+    recording.count = 0;
+    recording.dropped = 0;
+    recording.last_us = hal_time_us();
+    return recorded_read;
+}
+
+unsigned int input_recorded(const unsigned int **events) {
+    *events = recording.events;
+    return recording.count;
+}
+
+void input_dump(void) {
+    printf("INPUT %d events, %d dropped\n", recording.count, recording.dropped);
+    for(unsigned int i = 0; i < recording.count; i++) {
+        printf("%d %02x\n", INPUT_EVENT_MS(recording.events[i]), (unsigned char)INPUT_EVENT_KEY(recording.events[i]));
+    }
+    printf("END INPUT\n");
+}
+
+/* Function: replayed_read()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns the next key of the session, or reads one from the fallback
+ * input function once the session is over. When paced, waits until the
+ * key is due: as long after the previous key as it came in the
+ * recording, however long the app took to draw in between.
+ */
+static char replayed_read(void) {
+    if(replay.next >= replay.count) return replay.then();
+    unsigned int event = replay.events[replay.next++];
+    if(replay.paced) {
+        replay.due_us += (unsigned long)INPUT_EVENT_MS(event) * 1000;
+        unsigned long now = hal_time_us();
+        if(now < replay.due_us) hal_delay_us(replay.due_us - now);
+        else replay.due_us = now;
+    }
+    return INPUT_EVENT_KEY(event);
+}
+
+input_fn_t input_replay(const unsigned int *events, unsigned int count, bool paced, input_fn_t then) {
+    replay.events = events;
+    replay.count = count;
+    replay.next = 0;
+    replay.paced = paced;
+    replay.due_us = hal_time_us();
+    replay.then = then;
+    return replayed_read;
+}
@@ -0,0 +1,78 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+/*
+ * Record and replay of the keys an operator presses. The recorder sits
+ * between the printer app and its input function, keeping every key with
+ * the time since the previous one in a fixed buffer of packed 32-bit
+ * events, and `input_dump` prints the buffer over UART. The replayer is an
+ * input function that hands a recorded session back to the app, so the
+ * same session can be run again on the printer (compiled in from
+ * `input_session.c`, made by `pyconversion/input_session.py`) or on the
+ * host (`host/ui --replay`), as a repeatable workload.
+ *
+ * Replayed keys lead to the same frames and the same jobs, except for
+ * what depends on the clock (the timings overlay, ETAs of prints).
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+
+// Library Imports
+#include "shell.h"
+
+// Constants
+#define INPUT_LOG_EVENTS 1024
+#define INPUT_KEY_BITS 8
+#define INPUT_MS_MAX 0xFFFFFF // longest gap between keys that can be recorded (~4.6 hours)
+
+// Packing of an event: the milliseconds since the previous key in the top 24 bits, the key in the low 8
+#define INPUT_EVENT(ms, key) (((ms) << INPUT_KEY_BITS) | (unsigned char)(key))
+#define INPUT_EVENT_MS(event) ((event) >> INPUT_KEY_BITS)
+#define INPUT_EVENT_KEY(event) ((char)((event) & 0xff))
+
+// The session compiled into the firmware (`input_session.c`)
+extern const unsigned int INPUT_SESSION[];
+extern const unsigned int INPUT_SESSION_SIZE;
+
+/*
+ * `input_record`
+ *
+ * Starts recording the keys read through `read_fn` (forgetting any earlier recording). Once the buffer
+ * is full keys are still read, but no longer recorded.
+ *
+ * @param read_fn     the input function to record
+ * @return            the input function to read keys with instead
+ */
+input_fn_t input_record(input_fn_t read_fn);
+
+/*
+ * `input_recorded`
+ *
+ * @param events      set to the recorded events
+ * @return            the number of events recorded
+ */
+unsigned int input_recorded(const unsigned int **events);
+
+/*
+ * `input_dump`
+ *
+ * Prints the recorded events over UART, one "<ms> <key in hex>" line each, between "INPUT" and
+ * "END INPUT" lines.
+ */
+void input_dump(void);
+
+/*
+ * `input_replay`
+ *
+ * Makes an input function that returns the keys of a recorded session, then the keys of `then`.
+ *
+ * @param events      the recorded events
+ * @param count       the number of events
+ * @param paced       true to wait as long before each key as the operator did, false to return them at once
+ * @param then        the input function to read from once the session is over
+ * @return            the input function
+ */
+input_fn_t input_replay(const unsigned int *events, unsigned int count, bool paced, input_fn_t then);
+
+#endif
@@ -0,0 +1,13 @@
+/* File: input_session.c
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Operator session replayed at boot when REPLAY_SESSION is on in
+ * `davinci.c`. Regenerate from a UART capture holding an `input_dump`
+ * with `python3 pyconversion/input_session.py capture > input_session.c`.
+ */
+
+// Project Imports
+#include "input_log.h"
+
+// No session recorded
+const unsigned int INPUT_SESSION[] = { 0 };
+const unsigned int INPUT_SESSION_SIZE = 0;
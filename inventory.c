@@ -0,0 +1,117 @@
+/* File: inventory.c
+ * =-=-=-=-=-=-=-=-=
+ * Keeps count of the bricks in the cartridges, and of the ones print
+ * jobs have reserved.
+ */
+
+// Project Imports
+#include "inventory.h"
+
+/* Function: stock_of()
+ * =-=-=-=-=-=-=-=-=-=-
+ * Returns the cartridge a cartridge's bricks come from (itself, unless
+ * it is a copy).
+ */
+static struct cartridge *stock_of(const struct cartridge *cartridge) {
+    return cartridge->stock ? cartridge->stock : (struct cartridge *)cartridge;
+}
+
+/* Function: inventory_available()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Bricks in the stock, less the ones reserved.
+ */
+unsigned int inventory_available(const struct cartridge *cartridge) {
+    const struct cartridge *stock = stock_of(cartridge);
+    return stock->capacity - stock->reserved;
+}
+
+/* Function: inventory_count()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Bricks in the stock.
+ */
+unsigned int inventory_count(const struct cartridge *cartridge) {
+    return stock_of(cartridge)->capacity;
+}
+
+/* Function: count_range()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Counts the bricks of the range per cartridge (the job's demand when
+ * the range is the whole job).
+ */
+static void count_range(unsigned int *count, const struct placement_list *list, unsigned int first, unsigned int last) {
+    for(int c = 0; c < PLACEMENT_MAX_CARTRIDGES; c++) count[c] = (first == 0 && last == list->count) ? list->demand[c] : 0;
+    if(first != 0 || last != list->count) {
+        for(unsigned int i = first; i < last && i < list->count; i++) {
+            if(list->bricks[i].cartridge < PLACEMENT_MAX_CARTRIDGES) count[list->bricks[i].cartridge]++;
+        }
+    }
+}
+
+/* Function: inventory_reserve()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Counts the bricks of the range per cartridge, checks them all against
+ * what is available, then holds them back.
+ */
+bool inventory_reserve(struct reservation *reservation, const struct placement_list *list, unsigned int first, unsigned int last) {
+    reservation->color_map = list->color_map;
+    count_range(reservation->held, list, first, last);
+
+    // All or nothing
+    if(inventory_shortfall(list, first, last, NULL)) {
+        for(int c = 0; c < PLACEMENT_MAX_CARTRIDGES; c++) reservation->held[c] = 0;
+        return false;
+    }
+    unsigned int num_cartridges = list->color_map->num_cartridges;
+    if(num_cartridges > PLACEMENT_MAX_CARTRIDGES) num_cartridges = PLACEMENT_MAX_CARTRIDGES;
+    for(unsigned int c = 0; c < num_cartridges; c++) stock_of(&list->color_map->list_cartridges[c])->reserved += reservation->held[c];
+    return true;
+}
+
+/* Function: inventory_shortfall()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Adds up, over the cartridges, the bricks the range needs past what is
+ * available, and finds the cartridge short of the most.
+ */
+unsigned int inventory_shortfall(const struct placement_list *list, unsigned int first, unsigned int last, unsigned int *worst) {
+    unsigned int count[PLACEMENT_MAX_CARTRIDGES];
+    count_range(count, list, first, last);
+
+    unsigned int num_cartridges = list->color_map->num_cartridges;
+    if(num_cartridges > PLACEMENT_MAX_CARTRIDGES) num_cartridges = PLACEMENT_MAX_CARTRIDGES;
+    unsigned int total = 0, most = 0;
+    for(unsigned int c = 0; c < num_cartridges; c++) {
+        unsigned int available = inventory_available(&list->color_map->list_cartridges[c]);
+        if(count[c] <= available) continue;
+        total += count[c] - available;
+        if(count[c] - available > most) {
+            most = count[c] - available;
+            if(worst) *worst = c;
+        }
+    }
+    return total;
+}
+
+/* Function: inventory_commit()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Moves one brick from reserved to gone (a brick the job did not
+ * reserve, or with no cartridge, changes nothing).
+ */
+void inventory_commit(struct reservation *reservation, unsigned int cartridge) {
+    if(cartridge >= PLACEMENT_MAX_CARTRIDGES || !reservation->held[cartridge]) return;
+    struct cartridge *stock = stock_of(&reservation->color_map->list_cartridges[cartridge]);
+    reservation->held[cartridge]--;
+    stock->reserved--;
+    stock->capacity--;
+}
+
+/* Function: inventory_release()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Hands back what is still held, cartridge by cartridge.
+ */
+void inventory_release(struct reservation *reservation) {
+    for(int c = 0; c < PLACEMENT_MAX_CARTRIDGES; c++) {
+        if(!reservation->held[c]) continue;
+        stock_of(&reservation->color_map->list_cartridges[c])->reserved -= reservation->held[c];
+        reservation->held[c] = 0;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+/*
+ * Brick inventory: how many bricks each cartridge holds, and how many
+ * of them print jobs have claimed. The capacities of the cartridges only
+ * change here. A job reserves all the bricks it needs before it starts,
+ * commits them one by one as they are placed, and releases whatever it
+ * did not place when it stops, so the bricks it holds never go to
+ * another job and a job cut short gives them back. Everything else
+ * (quantizing, ranking, previews) only reads what is available.
+ *
+ * Cartridges copied out of another color map (the picks of the AUTO
+ * color map) keep a pointer to the cartridge they were copied from, so
+ * their bricks come out of the same stock.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+
+// Project Imports
+#include "colormaps.h"
+#include "placement.h"
+
+// Contains the bricks a job holds back from each cartridge of its color map until they are placed (or released)
+struct reservation {
+    const struct printer *color_map;
+    unsigned int held[PLACEMENT_MAX_CARTRIDGES];
+};
+
+/*
+ * `inventory_available`
+ *
+ * @param cartridge   the cartridge (or a copy of it)
+ *
+ * @return            the bricks left in the cartridge's stock that no job has reserved
+ */
+unsigned int inventory_available(const struct cartridge *cartridge);
+
+/*
+ * `inventory_count`
+ *
+ * @param cartridge   the cartridge (or a copy of it)
+ *
+ * @return            the bricks left in the cartridge's stock, reserved or not
+ */
+unsigned int inventory_count(const struct cartridge *cartridge);
+
+/*
+ * `inventory_reserve`
+ *
+ * Reserves the bricks a range of a job's bricks needs from each cartridge, all or nothing.
+ *
+ * @param reservation the reservation to fill in (empty if it fails)
+ * @param list        the placement list of the job
+ * @param first       the index of the first brick to place
+ * @param last        one past the index of the last brick to place
+ *
+ * @return            true if every cartridge had the bricks available
+ */
+bool inventory_reserve(struct reservation *reservation, const struct placement_list *list, unsigned int first, unsigned int last);
+
+/*
+ * `inventory_shortfall`
+ *
+ * @param list        the placement list of the job
+ * @param first       the index of the first brick to place
+ * @param last        one past the index of the last brick to place
+ * @param worst       set to the index of the cartridge short of the most bricks (untouched if none is, may be NULL)
+ *
+ * @return            the bricks the range needs that its cartridges do not have available (0 if it can be reserved)
+ */
+unsigned int inventory_shortfall(const struct placement_list *list, unsigned int first, unsigned int last, unsigned int *worst);
+
+/*
+ * `inventory_commit`
+ *
+ * Takes a placed brick out of its cartridge, and out of the job's reservation.
+ *
+ * @param reservation the reservation of the job
+ * @param cartridge   the index of the brick's cartridge in the job's color map
+ */
+void inventory_commit(struct reservation *reservation, unsigned int cartridge);
+
+/*
+ * `inventory_release`
+ *
+ * Gives back the bricks a job reserved and did not place.
+ *
+ * @param reservation the reservation of the job (empty after)
+ */
+void inventory_release(struct reservation *reservation);
+
+#endif
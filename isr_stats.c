@@ -0,0 +1,95 @@
+/* File: isr_stats.c
+ * =-=-=-=-=-=-=-=-=
+ * Lateness and run time histograms of the stepper interrupt.
+ */
+
+// Library Imports
+#include "printf.h"
+
+// Project Imports
+#include "hal.h"
+#include "isr_stats.h"
+#include "trace.h"
+
+static volatile struct isr_stats stats;
+static unsigned long last_entry;
+
+void isr_stats_reset(unsigned int period_us) {
+    // Stop recording while the stats are cleared
+    stats.period = 0;
+    stats.ticks = 0;
+    stats.missed = 0;
+    stats.overruns = 0;
+    stats.max_late = 0;
+    stats.max_duration = 0;
+    for(int b = 0; b < ISR_BUCKETS; b++) {
+        stats.late[b] = 0;
+        stats.duration[b] = 0;
+    }
+    unsigned long us = hal_time_us();
+    stats.cycles_per_us = us ? hal_cycles() / us : 0;
+    if(stats.cycles_per_us == 0) stats.cycles_per_us = 1;
+    stats.period = period_us * stats.cycles_per_us;
+}
+
+/* Function: bucket()
+ * =-=-=-=-=-=-=-=-=-
+ * Returns the histogram bucket of a time in cycles.
+ */
+static int bucket(unsigned long cycles) {
+    int b = 0;
+    while(b < ISR_BUCKETS - 1 && cycles >= (stats.cycles_per_us << b)) b++;
+    return b;
+}
+
+/* Function: isr_stats_record()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Runs in the interrupt. A tick is late by however much longer than a
+ * period it came after the previous one; a gap of several periods counts
+ * the ticks in between as missed, and only the remainder as lateness.
+ */
+void isr_stats_record(unsigned long entry, unsigned long exit) {
+    unsigned long period = stats.period;
+    if(!period) return;
+
+    if(stats.ticks) {
+        unsigned long interval = entry - last_entry, late = 0;
+        if(interval >= period + period / 2) {
+            unsigned long skipped = (interval + period / 2) / period - 1;
+            stats.missed += skipped;
+            interval -= skipped * period;
+        }
+        if(interval > period) late = interval - period;
+        if(late > stats.max_late) stats.max_late = late;
+        stats.late[bucket(late)]++;
+    }
+    last_entry = entry;
+
+    unsigned long duration = exit - entry;
+    if(duration > stats.max_duration) stats.max_duration = duration;
+    if(duration >= period) stats.overruns++;
+    stats.duration[bucket(duration)]++;
+    stats.ticks++;
+}
+
+const volatile struct isr_stats *isr_stats_get(void) {
+    return &stats;
+}
+
+unsigned long isr_stats_ns(unsigned long cycles) {
+    return stats.cycles_per_us ? cycles * 1000 / stats.cycles_per_us : 0;
+}
+
+void isr_stats_trace(void) {
+    trace_stats(TRACE_ISR, isr_stats_ns(stats.max_late), isr_stats_ns(stats.max_duration), stats.missed, stats.overruns, stats.ticks, 0);
+}
+
+void isr_stats_print(void) {
+    printf("Stepper interrupt: %ld ticks, %ld missed, %ld overruns, worst %ld ns late, longest run %ld ns\n", stats.ticks,
+           stats.missed, stats.overruns, isr_stats_ns(stats.max_late), isr_stats_ns(stats.max_duration));
+    for(int b = 0; b < ISR_BUCKETS; b++) {
+        if(b < ISR_BUCKETS - 1) printf("  [%d, %d) us:", b ? 1 << (b - 1) : 0, 1 << b);
+        else printf("  [%d, inf) us:", 1 << (b - 1));
+        printf(" late %ld, run %ld\n", stats.late[b], stats.duration[b]);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef ISR_STATS_H
+#define ISR_STATS_H
+
+/*
+ * Timing of the stepper interrupt. Every run of `steppers` is timestamped
+ * on entry and exit (with `hal_cycles`), and the stats below show how
+ * well the steppers are being served: how late each tick came compared
+ * with the one before (so a busy main loop or a long interrupt elsewhere
+ * shows up as lateness), how long the handler ran, the worst of each,
+ * ticks missed outright, and runs that took longer than a tick.
+ *
+ * Histograms have power-of-two buckets in microseconds: [0, 1), [1, 2),
+ * [2, 4) ... [64, inf).
+ */
+
+// Constants
+#define ISR_BUCKETS 8
+
+// Contains the stats of the stepper interrupt since `isr_stats_reset` (all times in cycles)
+struct isr_stats {
+    unsigned long ticks, missed, overruns;
+    unsigned long max_late, max_duration;
+    unsigned long late[ISR_BUCKETS], duration[ISR_BUCKETS];
+    unsigned long cycles_per_us, period;
+};
+
+/*
+ * `isr_stats_reset`
+ *
+ * Starts the stats afresh, measuring the rate of the cycle counter (against `hal_time_us` since boot) to size
+ * the buckets. Nothing is recorded before the first reset.
+ *
+ * @param period_us   microseconds between ticks of the interrupt
+ */
+void isr_stats_reset(unsigned int period_us);
+
+/*
+ * `isr_stats_record`
+ *
+ * Records one run of the interrupt (call at the end of the handler).
+ *
+ * @param entry       `hal_cycles()` on entry to the handler
+ * @param exit        `hal_cycles()` on exit
+ */
+void isr_stats_record(unsigned long entry, unsigned long exit);
+
+/*
+ * `isr_stats_get`
+ *
+ * @return            the stats so far (updated by the interrupt while being read)
+ */
+const volatile struct isr_stats *isr_stats_get(void);
+
+/*
+ * `isr_stats_ns`
+ *
+ * @param cycles      a time in cycles
+ *
+ * @return            `cycles` in nanoseconds
+ */
+unsigned long isr_stats_ns(unsigned long cycles);
+
+/*
+ * `isr_stats_trace`
+ *
+ * Adds the worst lateness and run time, missed ticks and overruns so far to the motion trace.
+ */
+void isr_stats_trace(void);
+
+/*
+ * `isr_stats_print`
+ *
+ * Prints the stats and both histograms over UART.
+ */
+void isr_stats_print(void);
+
+#endif
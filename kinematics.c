@@ -0,0 +1,62 @@
+/* File: kinematics.c
+ * =-=-=-=-=-=-=-=-=-
+ * Kinematics table of the printer. Every motion constant of the machine
+ * lives here (per-axis speeds, ramps and soft limits, and the positions
+ * of the build plate, feeder and nozzle heights).
+ */ 
+
+// Library Imports
+#include "printf.h"
+
+// Project Imports
+#include "kinematics.h"
+
+// Machine table
+struct machine_config machine = {
+    .axes = {
+        // name, steps/mm, start interval, min interval, decel steps, soft min, soft max
+        [AXIS_X] = {"X", 400, 150, 7, 100, 0, 120000},
+        [AXIS_Y] = {"Y", 400, 150, 7, 100, 0, 70000},
+        [AXIS_Z] = {"Z", 400, 150, 10, 100, 0, 10000},
+    },
+    .brick_pitch_mm = 8,
+    .plate_x = 45000,
+    .plate_y = 3000,
+    .feeder_x = 700,
+    .feeder_y = 3500,
+    .feeder_pitch = 4000,
+    .travel_z = 3000,
+    .clear_z = 5000,
+    .pick_z = 8000,
+    .place_z = 9000,
+};
+
+/* Function: brick_pitch()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Returns the brick pitch of `axis` in steps.
+ */
+int brick_pitch(int axis) {
+    return machine.brick_pitch_mm * machine.axes[axis].steps_per_mm;
+}
+
+/* Function: axis_interval()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns `speed`, or the top speed of `axis` if `speed` is faster.
+ */
+int axis_interval(int axis, int speed) {
+    if(speed < machine.axes[axis].min_interval) return machine.axes[axis].min_interval;
+    return speed;
+}
+
+/* Function: within_limits()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Checks `position` against the soft limits of `axis`.
+ */
+bool within_limits(int axis, int position) {
+    const struct axis_config *config = &machine.axes[axis];
+    if(position < config->soft_min || position > config->soft_max) {
+        printf("%s position %d past soft limit, refusing the move\n", config->name, position);
+        return false;
+    }
+    return true;
+}
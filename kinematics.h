@@ -0,0 +1,85 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+/*
+ * Machine kinematics of the printer. Holds the per-axis motion limits
+ * (speeds, ramps and soft limits) alongside the named positions of the
+ * build plate, feeder and nozzle heights, so retuning the machine only
+ * means editing the table in `kinematics.c`.
+ *
+ * Speeds are step intervals in stepper timer ticks: a smaller interval
+ * is a faster axis.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+
+// Axis Indices
+#define AXIS_X 0
+#define AXIS_Y 1
+#define AXIS_Z 2
+#define NUM_AXES 3
+
+// Speed that runs every axis at its own top speed
+#define SPEED_MAX 0
+
+// Contains the motion limits of one axis
+struct axis_config {
+    const char* name;
+    int steps_per_mm;                 // steps per millimeter of travel
+    int start_interval;               // interval every move starts (and ends) at - lower speed = more torque
+    int min_interval;                 // interval of the axis' top speed
+    int decel_steps;                  // steps before the end of a move the axis starts slowing down
+    int soft_min, soft_max;           // range of positions the axis may be sent to
+};
+
+// Contains the limits of each axis, and the named positions of the machine (in steps)
+struct machine_config {
+    struct axis_config axes[NUM_AXES];
+    int brick_pitch_mm;               // distance between neighboring bricks on the build plate
+    int plate_x, plate_y;             // position of brick {0, 0} on the build plate
+    int feeder_x, feeder_y;           // pickup position of feeder slot 0
+    int feeder_pitch;                 // X distance between neighboring feeder slots
+    int travel_z;                     // nozzle height for traveling
+    int clear_z;                      // lowest nozzle height XY travel is allowed at
+    int pick_z, place_z;              // nozzle heights for picking up and placing a brick
+};
+
+extern struct machine_config machine;
+
+/*
+ * `brick_pitch`
+ *
+ * Returns the distance between neighboring bricks on the build plate along an axis.
+ *
+ * @param axis        the axis (AXIS_X or AXIS_Y)
+ *
+ * @return            the brick pitch in steps
+ */
+int brick_pitch(int axis);
+
+/*
+ * `axis_interval`
+ *
+ * Returns the step interval an axis moves at for a requested speed, never faster than the axis' top speed.
+ *
+ * @param axis        the axis being moved
+ * @param speed       the requested interval (SPEED_MAX for the axis' top speed)
+ *
+ * @return            the interval to move the axis at
+ */
+int axis_interval(int axis, int speed);
+
+/*
+ * `within_limits`
+ *
+ * Checks a target position against the soft limits of an axis.
+ *
+ * @param axis        the axis being moved
+ * @param position    the requested position in steps
+ *
+ * @return            true if the position is within the axis' soft limits
+ */
+bool within_limits(int axis, int position);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef LAB_TABLES_H
+#define LAB_TABLES_H
+
+/*
+ * Fixed-point lookup tables for converting colors to CIE Lab without
+ * floating point: the linear light of each sRGB channel value, the
+ * matrix from linear RGB to XYZ, and the cube root Lab applies to X, Y
+ * and Z. Generated into `lab_tables.c` by
+ * `pyconversion/lab_tables.py`.
+ */
+
+// Constants (must match `pyconversion/lab_tables.py`)
+#define LAB_LINEAR_ONE 4095 // linear light of a full channel (and of the white point in XYZ)
+#define LAB_F_BITS 10       // bits after the point of LAB_F
+#define LAB_XYZ_BITS 12     // bits after the point of LAB_XYZ
+
+// Linear light of each 8-bit sRGB channel value
+extern const unsigned short LAB_LINEAR[256];
+
+// Cube root of each normalized X, Y or Z value, from 0 to LAB_LINEAR_ONE
+extern const unsigned short LAB_F[LAB_LINEAR_ONE + 1];
+
+// Linear RGB to X, Y and Z, each divided by the white point's (so white is LAB_LINEAR_ONE in all three)
+extern const unsigned short LAB_XYZ[3][3];
+
+#endif
@@ -0,0 +1,455 @@
+/* File: motion_program.c
+ * =-=-=-=-=-=-=-=-=-=-=-
+ * Compiles print jobs into motion bytecode, and streams that bytecode
+ * to the stepper driver. Also caches compiled jobs so printing the same
+ * job again (or replaying it) skips the compile.
+ */ 
+
+// Library Imports
+#include "malloc.h"
+#include "printf.h"
+
+// Project Imports
+#include "motion_program.h"
+#include "feeder_layout.h"
+#include "hal.h"
+#include "kinematics.h"
+#include "printer_driver.h"
+#include "trace.h"
+
+// Constants
+#define PROGRAM_CACHE_SIZE 4
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+// Cached programs, replaced round robin
+static struct {
+    unsigned int image, colormap, scale, checksum;
+    struct motion_program *program;
+} cache[PROGRAM_CACHE_SIZE];
+static unsigned int cache_next = 0;
+
+/* Function: emit_byte()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Appends a byte to `program` (dropped if the program is full).
+ */
+static void emit_byte(struct motion_program *program, unsigned int value) {
+    if(program->length < program->capacity) program->code[program->length] = value & 0xff;
+    program->length++;
+}
+
+/* Function: emit_u24()
+ * =-=-=-=-=-=-=-=-=-=-
+ * Appends a 24 bit little endian value to `program`.
+ */
+static void emit_u24(struct motion_program *program, unsigned int value) {
+    emit_byte(program, value);
+    emit_byte(program, value >> 8);
+    emit_byte(program, value >> 16);
+}
+
+/* Function: read_u24()
+ * =-=-=-=-=-=-=-=-=-=-
+ * Reads a 24 bit little endian value at `*pc`, advancing `*pc`.
+ */
+static unsigned int read_u24(const struct motion_program *program, unsigned int *pc) {
+    unsigned int value = program->code[*pc] | (program->code[*pc + 1] << 8) | (program->code[*pc + 2] << 16);
+    *pc += 3;
+    return value;
+}
+
+/* Function: emit_move()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Appends a move to {x, y, z}, leaving out axes already at their target
+ * (and the whole move if nothing has to move).
+ */
+static void emit_move(struct motion_program *program, int x, int y, int z) {
+    unsigned int mask = 0;
+    if(x != program->x) mask |= MASK_X;
+    if(y != program->y) mask |= MASK_Y;
+    if(z != program->z) mask |= MASK_Z;
+    if(!mask) return;
+
+    emit_byte(program, OP_MOVE);
+    emit_byte(program, mask);
+    emit_byte(program, SPEED_MAX);
+    if(mask & MASK_X) emit_u24(program, x);
+    if(mask & MASK_Y) emit_u24(program, y);
+    if(mask & MASK_Z) emit_u24(program, z);
+    program->x = x;
+    program->y = y;
+    program->z = z;
+}
+
+/* Function: emit_travel()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Appends a blended travel to {x, y} ending with the nozzle heading down
+ * to `z_final`. The XY move starts as soon as the nozzle clears, and the
+ * descent starts once the XY move has less time left than the nozzle
+ * needs to get down to clearance height.
+ */
+static void emit_travel(struct motion_program *program, int x, int y, int z_final) {
+    // Retract (skipped when already at travel height)
+    emit_move(program, program->x, program->y, machine.travel_z);
+    emit_byte(program, OP_WAIT_CLEAR);
+
+    // Travel, with the descent overlapping its end
+    if(x != program->x || y != program->y) {
+        const struct axis_config *z = &machine.axes[AXIS_Z];
+        unsigned long lead = 0;
+        if(machine.clear_z > machine.travel_z) {
+            lead = ramp_ticks(z_final - machine.travel_z, z->start_interval, z->min_interval, z->decel_steps, machine.clear_z - machine.travel_z) * STEPPER_TICK_US;
+        }
+        emit_move(program, x, y, program->z);
+        emit_byte(program, OP_WAIT_XY);
+        emit_u24(program, lead);
+    }
+    emit_move(program, x, y, z_final);
+}
+
+/* Function: program_init()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Initializes an empty program.
+ */
+void program_init(struct motion_program *program, unsigned char *code, unsigned int capacity, int x, int y, int z) {
+    program->code = code;
+    program->length = 0;
+    program->capacity = capacity;
+    program->bricks = 0;
+    program->x = program->start_x = x;
+    program->y = program->start_y = y;
+    program->z = program->start_z = z;
+}
+
+/* Function: program_emit_cycle()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Appends a pick-and-place cycle from `pickup` to `place`. The final
+ * raise is left running so the next cycle (or the caller) overlaps it.
+ */
+void program_emit_cycle(struct motion_program *program, coordinate pickup, coordinate place) {
+    // Travel to the brick of the specified color, turning the vacuum on just before the nozzle reaches it
+    emit_travel(program, pickup.x, pickup.y, machine.pick_z);
+    emit_byte(program, OP_WAIT_Z);
+    emit_u24(program, cycle_config.vacuum_on_lead_us);
+    emit_byte(program, OP_VACUUM_ON);
+    emit_byte(program, OP_WAIT_IDLE);
+
+    // Travel to the end position of the brick, turning the vacuum off just before placing it
+    emit_travel(program, place.x, place.y, machine.place_z);
+    emit_byte(program, OP_WAIT_Z);
+    emit_u24(program, cycle_config.vacuum_off_lead_us);
+    emit_byte(program, OP_VACUUM_OFF);
+    emit_byte(program, OP_WAIT_IDLE);
+
+    // Raise the arm
+    emit_move(program, place.x, place.y, machine.travel_z);
+}
+
+/* Function: program_emit_end()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Appends the end of the program.
+ */
+void program_emit_end(struct motion_program *program) {
+    emit_byte(program, OP_WAIT_IDLE);
+    emit_byte(program, OP_END);
+}
+
+/* Function: program_compile()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Compiles a whole print job into a motion program.
+ */
+struct motion_program* program_compile(const struct placement_list *list) {
+    return program_compile_range(list, 0, list->count);
+}
+
+/* Function: program_compile_range()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Compiles bricks `first` up to (not including) `last` of a print job
+ * into a motion program.
+ */
+struct motion_program* program_compile_range(const struct placement_list *list, unsigned int first, unsigned int last) {
+    if(last > list->count) last = list->count;
+    if(first > last) first = last;
+
+    // Size the program for the worst case cycle of every brick
+    unsigned int capacity = HOME_CODE_SIZE + (last - first) * (CYCLE_CODE_SIZE + PROGRESS_CODE_SIZE) + END_CODE_SIZE;
+    struct motion_program *program = malloc(sizeof(struct motion_program) + capacity);
+    program_init(program, (unsigned char *)(program + 1), capacity, 0, 0, 0);
+
+    // Home, then one cycle and progress marker per brick (a brick with no cartridge has nothing to pick up, so it is left out)
+    emit_byte(program, OP_HOME);
+    for(int i = first; i < last; i++) {
+        const struct placement *brick = &list->bricks[i];
+        if(brick->cartridge == PLACEMENT_NO_CARTRIDGE) continue;
+        unsigned int cycle_start = program->length;
+        program_emit_cycle(program, feeder_pickup(brick->cartridge), brick_position(brick->x, brick->y));
+        if(program->length - cycle_start > CYCLE_CODE_SIZE) {
+            printf("Motion program: cycle of brick %d takes %d bytes, past CYCLE_CODE_SIZE\n", i, program->length - cycle_start);
+        }
+        emit_byte(program, OP_PROGRESS);
+        emit_byte(program, i);
+        emit_byte(program, i >> 8);
+        program->bricks++;
+    }
+    program_emit_end(program);
+    if(program->length > program->capacity) {
+        printf("Motion program: %d bytes do not fit in %d, refusing to run it\n", program->length, program->capacity);
+    }
+
+    return program;
+}
+
+/* Function: program_free()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Frees a compiled program.
+ */
+void program_free(struct motion_program *program) {
+    free(program);
+}
+
+/* Function: program_run()
+ * =-=-=-=-=-=-=-=-=-=-=-=
+ * Executes instructions from `*pc` until the next progress marker,
+ * the end of the program, or a motion fault.
+ */
+int program_run(const struct motion_program *program, unsigned int *pc) {
+    // A program that overflowed its buffer was cut short, so none of it runs
+    if(program->length > program->capacity) return PROGRAM_FAULT;
+
+    while(*pc < program->length && *pc < program->capacity) {
+        // Homing clears a fault (if it finds every switch), so a program that starts by homing can resume a faulted job
+        if(motion_faulted() && program->code[*pc] != OP_HOME) return PROGRAM_FAULT;
+
+        unsigned int op = program->code[(*pc)++];
+        if(op == OP_END) {
+            (*pc)--;
+            return PROGRAM_END;
+        }
+        else if(op == OP_MOVE) {
+            unsigned int mask = program->code[(*pc)++];
+            int speed = program->code[(*pc)++];
+            int x = axis_position(AXIS_X), y = axis_position(AXIS_Y), z = axis_position(AXIS_Z);
+            if(mask & MASK_X) x = read_u24(program, pc);
+            if(mask & MASK_Y) y = read_u24(program, pc);
+            if(mask & MASK_Z) z = read_u24(program, pc);
+            move_to_async(x, y, z, speed);
+        }
+        else if(op == OP_WAIT_IDLE) wait_for_motion();
+        else if(op == OP_WAIT_CLEAR) wait_for_clearance();
+        else if(op == OP_WAIT_XY) wait_for_xy(read_u24(program, pc));
+        else if(op == OP_WAIT_Z) wait_for_z(read_u24(program, pc));
+        else if(op == OP_VACUUM_ON) activate_vacuum();
+        else if(op == OP_VACUUM_OFF) deactivate_vacuum();
+        else if(op == OP_HOME && !home_steppers()) return PROGRAM_FAULT;
+        else if(op == OP_PROGRESS) {
+            int brick = program->code[*pc] | (program->code[*pc + 1] << 8);
+            *pc += 2;
+            trace_event(TRACE_BRICK, brick, 0, 0, false);
+            return brick;
+        }
+    }
+    return motion_faulted() ? PROGRAM_FAULT : PROGRAM_END;
+}
+
+/* Function: program_replay()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Runs a whole program and returns how long it took.
+ */
+unsigned long program_replay(const struct motion_program *program) {
+    unsigned long start = hal_time_us();
+    unsigned int pc = 0;
+    while(program_run(program, &pc) >= 0) {}
+    return hal_time_us() - start;
+}
+
+// Model of one axis used by the estimator: where its current move goes, and when it started and ends
+struct axis_model {
+    int position, steps, target;
+    unsigned long start_us, end_us;
+};
+
+/* Function: model_move()
+ * =-=-=-=-=-=-=-=-=-=-=-
+ * Starts a modeled move of `axis` to `to` at time `*now`, the way
+ * `move_to_async` does: skipped when the axis is already there (or the
+ * target is past the soft limits, which the driver refuses), and waiting
+ * for the axis' previous move to end.
+ */
+static void model_move(struct axis_model *model, int axis, int to, int speed, unsigned long *now) {
+    const struct axis_config *config = &machine.axes[axis];
+    if(to < config->soft_min || to > config->soft_max) return;
+    if(to == model->position) return;
+
+    if(*now < model->end_us) *now = model->end_us;
+    model->steps = (to > model->position) ? to - model->position : model->position - to;
+    model->target = axis_interval(axis, speed);
+    model->start_us = *now;
+    model->end_us = *now + ramp_ticks(model->steps, config->start_interval, model->target, config->decel_steps, model->steps) * STEPPER_TICK_US;
+    model->position = to;
+}
+
+/* Function: model_clearance()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Returns when a modeled Z axis rises past clearance height (or `now`
+ * if it is not rising through it).
+ */
+static unsigned long model_clearance(const struct axis_model *z, unsigned long now) {
+    const struct axis_config *config = &machine.axes[AXIS_Z];
+    int from = z->position + z->steps;
+    if(now >= z->end_us || z->position > machine.clear_z || from <= machine.clear_z) return now;
+
+    unsigned long clear = z->start_us + ramp_ticks(z->steps, config->start_interval, z->target, config->decel_steps, from - machine.clear_z) * STEPPER_TICK_US;
+    return (clear > now) ? clear : now;
+}
+
+/* Function: program_estimate()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Predicts how long a program takes by running it through a model of
+ * the driver: every move ramps exactly like the stepper interrupt, and
+ * every wait resolves to the time the driver would stop waiting.
+ */
+unsigned long program_estimate(const struct motion_program *program, unsigned long progress_us[]) {
+    struct axis_model axes[NUM_AXES] = {{0}};
+    axes[AXIS_X].position = program->start_x;
+    axes[AXIS_Y].position = program->start_y;
+    axes[AXIS_Z].position = program->start_z;
+    unsigned long now = 0;
+    unsigned int brick = 0;
+
+    unsigned int pc = 0;
+    while(pc < program->length && pc < program->capacity) {
+        unsigned int op = program->code[pc++];
+        if(op == OP_END) break;
+        else if(op == OP_MOVE) {
+            unsigned int mask = program->code[pc++];
+            int speed = program->code[pc++];
+            if(mask & MASK_X) model_move(&axes[AXIS_X], AXIS_X, read_u24(program, &pc), speed, &now);
+            if(mask & MASK_Y) model_move(&axes[AXIS_Y], AXIS_Y, read_u24(program, &pc), speed, &now);
+            if(mask & MASK_Z) model_move(&axes[AXIS_Z], AXIS_Z, read_u24(program, &pc), speed, &now);
+        }
+        else if(op == OP_WAIT_IDLE) {
+            for(int axis = 0; axis < NUM_AXES; axis++) {
+                if(axes[axis].end_us > now) now = axes[axis].end_us;
+            }
+        }
+        else if(op == OP_WAIT_CLEAR) now = model_clearance(&axes[AXIS_Z], now);
+        else if(op == OP_WAIT_XY || op == OP_WAIT_Z) {
+            unsigned long lead = read_u24(program, &pc);
+            for(int axis = 0; axis < NUM_AXES; axis++) {
+                if((axis == AXIS_Z) != (op == OP_WAIT_Z)) continue;
+                if(axes[axis].end_us > now + lead) now = axes[axis].end_us - lead;
+            }
+        }
+        else if(op == OP_HOME) {
+            for(int axis = 0; axis < NUM_AXES; axis++) {
+                if(axes[axis].end_us > now) now = axes[axis].end_us;
+            }
+            now += home_estimate(axes[AXIS_X].position, axes[AXIS_Y].position, axes[AXIS_Z].position);
+            for(int axis = 0; axis < NUM_AXES; axis++) {
+                axes[axis].position = 0;
+                axes[axis].end_us = now;
+            }
+        }
+        else if(op == OP_PROGRESS) {
+            pc += 2;
+            if(progress_us && brick < program->bricks) progress_us[brick] = now;
+            brick++;
+        }
+    }
+
+    // The program ends once the machine stops
+    for(int axis = 0; axis < NUM_AXES; axis++) {
+        if(axes[axis].end_us > now) now = axes[axis].end_us;
+    }
+    return now;
+}
+
+/* Function: program_dump()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Prints one line per instruction of `program`.
+ */
+void program_dump(const struct motion_program *program) {
+    printf("Motion program: %d bytes, %d bricks\n", program->length, program->bricks);
+    unsigned int pc = 0;
+    while(pc < program->length && pc < program->capacity) {
+        unsigned int at = pc;
+        unsigned int op = program->code[pc++];
+        if(op == OP_MOVE) {
+            unsigned int mask = program->code[pc++];
+            int speed = program->code[pc++];
+            printf("%05x: MOVE speed=%d", at, speed);
+            if(mask & MASK_X) printf(" X=%d", read_u24(program, &pc));
+            if(mask & MASK_Y) printf(" Y=%d", read_u24(program, &pc));
+            if(mask & MASK_Z) printf(" Z=%d", read_u24(program, &pc));
+            printf("\n");
+        }
+        else if(op == OP_WAIT_XY) printf("%05x: WAIT_XY %dus\n", at, read_u24(program, &pc));
+        else if(op == OP_WAIT_Z) printf("%05x: WAIT_Z %dus\n", at, read_u24(program, &pc));
+        else if(op == OP_PROGRESS) {
+            printf("%05x: PROGRESS %d\n", at, program->code[pc] | (program->code[pc + 1] << 8));
+            pc += 2;
+        }
+        else if(op == OP_WAIT_IDLE) printf("%05x: WAIT_IDLE\n", at);
+        else if(op == OP_WAIT_CLEAR) printf("%05x: WAIT_CLEAR\n", at);
+        else if(op == OP_VACUUM_ON) printf("%05x: VACUUM_ON\n", at);
+        else if(op == OP_VACUUM_OFF) printf("%05x: VACUUM_OFF\n", at);
+        else if(op == OP_HOME) printf("%05x: HOME\n", at);
+        else if(op == OP_END) {
+            printf("%05x: END\n", at);
+            break;
+        }
+        else {
+            printf("%05x: ??? %02x\n", at, op);
+            break;
+        }
+    }
+}
+
+/* Function: job_checksum()
+ * =-=-=-=-=-=-=-=-=-=-=-=-
+ * Hashes everything a compiled job depends on besides its cache key:
+ * the placement list, the color, stock and pickup of every cartridge
+ * (the same index of the AUTO color map names another cartridge once it
+ * is refilled), and the machine table.
+ */
+static unsigned int job_checksum(const struct placement_list *list) {
+    unsigned int hash = (FNV_OFFSET ^ placement_checksum(list)) * FNV_PRIME;
+    for(int c = 0; c < list->color_map->num_cartridges; c++) {
+        const struct cartridge *cartridge = &list->color_map->list_cartridges[c];
+        const struct cartridge *stock = cartridge->stock ? cartridge->stock : cartridge;
+        coordinate pickup = feeder_pickup(c);
+        hash = (hash ^ cartridge->color) * FNV_PRIME;
+        hash = (hash ^ (unsigned int)(uintptr_t)stock) * FNV_PRIME;
+        hash = (hash ^ pickup.x) * FNV_PRIME;
+        hash = (hash ^ pickup.y) * FNV_PRIME;
+    }
+    const unsigned char *table = (const unsigned char *)&machine;
+    for(int i = 0; i < sizeof(machine); i++) hash = (hash ^ table[i]) * FNV_PRIME;
+    hash = (hash ^ cycle_config.vacuum_on_lead_us) * FNV_PRIME;
+    hash = (hash ^ cycle_config.vacuum_off_lead_us) * FNV_PRIME;
+    return hash;
+}
+
+/* Function: program_cache_get()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Looks a job up in the cache, compiling (and caching) it on a miss.
+ */
+const struct motion_program* program_cache_get(unsigned int image, unsigned int colormap, unsigned int scale, const struct placement_list *list) {
+    unsigned int checksum = job_checksum(list);
+    for(int i = 0; i < PROGRAM_CACHE_SIZE; i++) {
+        if(cache[i].program && cache[i].image == image && cache[i].colormap == colormap && cache[i].scale == scale && cache[i].checksum == checksum) {
+            return cache[i].program;
+        }
+    }
+
+    // Miss - compile into the next slot
+    if(cache[cache_next].program) program_free(cache[cache_next].program);
+    cache[cache_next].image = image;
+    cache[cache_next].colormap = colormap;
+    cache[cache_next].scale = scale;
+    cache[cache_next].checksum = checksum;
+    cache[cache_next].program = program_compile(list);
+    const struct motion_program *program = cache[cache_next].program;
+    cache_next = (cache_next + 1) % PROGRAM_CACHE_SIZE;
+    return program;
+}
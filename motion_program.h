@@ -0,0 +1,191 @@
+#ifndef MOTION_PROGRAM_H
+#define MOTION_PROGRAM_H
+
+/*
+ * Motion programs for the printer. A print job is compiled once into a
+ * compact bytecode of moves, waits, vacuum switches and progress markers,
+ * which is then streamed to the stepper driver one brick at a time. The
+ * compiled programs are cached per image, color map and scale mode.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+
+// Project Imports
+#include "placement.h"
+#include "printer_driver.h"
+
+// Opcodes (positions and times are 24 bit, progress markers 16 bit)
+#define OP_END 0x00               // end of program
+#define OP_MOVE 0x01              // axis mask, speed, then a position for each axis in the mask - starts the move
+#define OP_WAIT_IDLE 0x02         // waits for every axis to stop
+#define OP_WAIT_CLEAR 0x03        // waits for the nozzle to rise above clearance height
+#define OP_WAIT_XY 0x04           // time - waits until the XY move has at most this many microseconds left
+#define OP_WAIT_Z 0x05            // time - waits until the Z move has at most this many microseconds left
+#define OP_VACUUM_ON 0x06         // turns the vacuum on
+#define OP_VACUUM_OFF 0x07        // turns the vacuum off
+#define OP_PROGRESS 0x09          // brick - marks the brick (pixel index) as placed
+#define OP_HOME 0x0a              // homes all axes
+
+// Axis masks for OP_MOVE
+#define MASK_X 0x01
+#define MASK_Y 0x02
+#define MASK_Z 0x04
+
+// Return values of `program_run`
+#define PROGRAM_END -1
+#define PROGRAM_FAULT -2
+
+// Largest single pick-and-place cycle
+#define CYCLE_CODE_SIZE 96
+
+// Sizes of the rest of a compiled job: the homing it starts with, the progress marker after each cycle, and its end
+#define HOME_CODE_SIZE 1
+#define PROGRESS_CODE_SIZE 3
+#define END_CODE_SIZE 2
+
+// Contains the `code` of a program, the position the machine starts at, and the position it is at when the code
+// emitted so far finishes
+struct motion_program {
+    unsigned char *code;
+    unsigned int length, capacity;
+    unsigned int bricks;
+    int start_x, start_y, start_z;
+    int x, y, z;
+};
+
+/*
+ * `program_init`
+ *
+ * Initializes an empty program writing into `code`, starting from the position {x, y, z}.
+ *
+ * @param program     the program to initialize
+ * @param code        the buffer the bytecode is written to
+ * @param capacity    the size of `code`
+ * @param x           the X position the machine starts at
+ * @param y           the Y position the machine starts at
+ * @param z           the Z position the machine starts at
+ */
+void program_init(struct motion_program *program, unsigned char *code, unsigned int capacity, int x, int y, int z);
+
+/*
+ * `program_emit_cycle`
+ *
+ * Emits a blended pick-and-place cycle: XY travel overlaps the Z retract and approach wherever the
+ * nozzle is above clearance height, the vacuum switches its lead time before the nozzle stops, and
+ * moves to where the machine already is are skipped.
+ *
+ * @param program     the program to append to
+ * @param pickup      the position to pick the brick up from
+ * @param place       the position to place the brick at
+ */
+void program_emit_cycle(struct motion_program *program, coordinate pickup, coordinate place);
+
+/*
+ * `program_emit_end`
+ *
+ * Waits for the last move to finish and ends the program.
+ *
+ * @param program     the program to append to
+ */
+void program_emit_end(struct motion_program *program);
+
+/*
+ * `program_compile`
+ *
+ * Compiles a print job into a motion program: homes the printer, then picks and places every brick of
+ * `list` from the feeder slot of its cartridge, marking progress (the index of the brick in `list`) after each.
+ * Bricks with no cartridge (PLACEMENT_NO_CARTRIDGE) are left out of the program.
+ *
+ * @param list        the placement list of the job
+ *
+ * @return            the compiled program as type struct motion_program* (free with `program_free`)
+ */
+struct motion_program* program_compile(const struct placement_list *list);
+
+/*
+ * `program_compile_range`
+ *
+ * Compiles part of a print job (for resuming it, or placing some of its bricks again): homes the
+ * printer, then picks and places bricks `first` up to (not including) `last` of `list`.
+ *
+ * @param list        the placement list of the job
+ * @param first       the index of the first brick to place
+ * @param last        the index after the last brick to place
+ *
+ * @return            the compiled program as type struct motion_program* (free with `program_free`)
+ */
+struct motion_program* program_compile_range(const struct placement_list *list, unsigned int first, unsigned int last);
+
+/*
+ * `program_free`
+ *
+ * Frees a program returned by `program_compile` or `program_compile_range`.
+ *
+ * @param program     the program to free
+ */
+void program_free(struct motion_program *program);
+
+/*
+ * `program_run`
+ *
+ * Streams a program to the stepper driver from `*pc` until the next progress marker.
+ *
+ * @param program     the program to run
+ * @param pc          the offset to run from, advanced past the executed instructions
+ *
+ * @return            the brick of the progress marker reached, PROGRAM_END at the end of the program,
+ *                    or PROGRAM_FAULT if the machine faulted (or homing did not find its limit switches, or the
+ *                    program overflowed its buffer)
+ */
+int program_run(const struct motion_program *program, unsigned int *pc);
+
+/*
+ * `program_replay`
+ *
+ * Runs a whole program, timing it (used for benchmarking the motion of a job).
+ *
+ * @param program     the program to run
+ *
+ * @return            the time taken in microseconds
+ */
+unsigned long program_replay(const struct motion_program *program);
+
+/*
+ * `program_estimate`
+ *
+ * Predicts how long a program takes to run, using the same ramps and waits as the stepper driver.
+ *
+ * @param program       the program to estimate
+ * @param progress_us   if not NULL, filled with the predicted time (from the start) each brick is placed at,
+ *                      one entry per brick of the program
+ *
+ * @return              the predicted duration in microseconds
+ */
+unsigned long program_estimate(const struct motion_program *program, unsigned long progress_us[]);
+
+/*
+ * `program_dump`
+ *
+ * Prints a listing of a program over UART.
+ *
+ * @param program     the program to print
+ */
+void program_dump(const struct motion_program *program);
+
+/*
+ * `program_cache_get`
+ *
+ * Returns the compiled program for a job, only compiling it if the cache has no program for the same
+ * image, color map and scale mode with the same placements and feeder pickups.
+ *
+ * @param image       the index of the image in BITMAP_LIST
+ * @param colormap    the index of the color map in PRINTER_LIST
+ * @param scale       the index of the scale mode in SCALE_MODE_LIST
+ * @param list        the placement list of the job
+ *
+ * @return            the program (owned by the cache)
+ */
+const struct motion_program* program_cache_get(unsigned int image, unsigned int colormap, unsigned int scale, const struct placement_list *list);
+
+#endif
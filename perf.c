@@ -0,0 +1,81 @@
+/* File: perf.c
+ * =-=-=-=-=-=-=
+ * Per-scope cycle counts and the overlay that shows them.
+ */
+
+// Library Imports
+#include "gl.h"
+#include "printf.h"
+
+// Project Imports
+#include "perf.h"
+
+// Constants
+#define OVERLAY_CHARS 32
+#define TIME_CHARS 24
+
+// Contains how many times a scope was entered, and the total, min and max cycles spent in it
+struct perf_stats {
+    unsigned long count, total, min, max;
+};
+
+static const char *const NAMES[NUM_PERF_SCOPES] = { "FRAME", "PREVIEW", "DWNSCALE", "FORMAT", "BRICK", " MOTION", " RENDER", " SWAP" };
+
+static struct perf_stats stats[NUM_PERF_SCOPES];
+
+void perf_record(enum perf_scope scope, unsigned long start) {
+    unsigned long cycles = hal_cycles() - start;
+    struct perf_stats *s = &stats[scope];
+    if(s->count == 0 || cycles < s->min) s->min = cycles;
+    if(cycles > s->max) s->max = cycles;
+    s->total += cycles;
+    s->count++;
+}
+
+void perf_reset(void) {
+    for(int scope = 0; scope < NUM_PERF_SCOPES; scope++) {
+        stats[scope].count = 0;
+        stats[scope].total = 0;
+        stats[scope].min = 0;
+        stats[scope].max = 0;
+    }
+}
+
+/* Function: format_ms()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Writes `cycles` as milliseconds with one decimal, at the rate the
+ * cycle counter has run since boot.
+ */
+static void format_ms(char *buf, size_t bufsize, unsigned long cycles) {
+    unsigned long us = hal_time_us(), total = hal_cycles();
+    unsigned long per_ms = us >= 1000 ? total / (us / 1000) : 0;
+    unsigned long tenths = per_ms ? cycles * 10 / per_ms : 0;
+    snprintf(buf, bufsize, "%ld.%ld", tenths / 10, tenths % 10);
+}
+
+int perf_height(void) {
+    return (NUM_PERF_SCOPES + 1) * gl_get_char_height() + 4;
+}
+
+void perf_draw(int x, int y) {
+    const int cw = gl_get_char_width(), ch = gl_get_char_height();
+    gl_draw_rect(x, y, OVERLAY_CHARS * cw + 4, perf_height(), GL_BLACK);
+    gl_draw_string(x + 2, y + 2, "SCOPE", GL_AMBER);
+    gl_draw_string(x + 2 + 9 * cw, y + 2, "AVG", GL_AMBER);
+    gl_draw_string(x + 2 + 17 * cw, y + 2, "MIN", GL_AMBER);
+    gl_draw_string(x + 2 + 25 * cw, y + 2, "MAX MS", GL_AMBER);
+
+    for(int scope = 0; scope < NUM_PERF_SCOPES; scope++) {
+        const struct perf_stats *s = &stats[scope];
+        int row = y + 2 + (scope + 1) * ch;
+        char time_str[TIME_CHARS];
+        gl_draw_string(x + 2, row, NAMES[scope], GL_WHITE);
+        if(s->count == 0) continue;
+        format_ms(time_str, TIME_CHARS, s->total / s->count);
+        gl_draw_string(x + 2 + 9 * cw, row, time_str, GL_WHITE);
+        format_ms(time_str, TIME_CHARS, s->min);
+        gl_draw_string(x + 2 + 17 * cw, row, time_str, GL_WHITE);
+        format_ms(time_str, TIME_CHARS, s->max);
+        gl_draw_string(x + 2 + 25 * cw, row, time_str, GL_WHITE);
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef PERF_H
+#define PERF_H
+
+/*
+ * Scoped timers. Each named scope keeps the count, total, min and max of
+ * the CPU cycles spent in it, in a fixed table (no allocation), and an
+ * overlay draws them in the corner of the screen in milliseconds.
+ *
+ *     PERF_BEGIN(PERF_PREVIEW);
+ *     ...
+ *     PERF_END(PERF_PREVIEW);
+ *
+ * Cycles are counted with `hal_cycles` and converted to time by
+ * comparing with `hal_time_us` since boot, so no clock rate is assumed.
+ */
+
+// Project Imports
+#include "hal.h"
+
+// Scopes timed (PERF_MOTION, PERF_RENDER and PERF_SWAP break one brick of `print_printer` down)
+enum perf_scope {
+    PERF_FRAME,         // one frame of `printer_run`, from clearing the screen to the swap
+    PERF_PREVIEW,       // `print_preview`
+    PERF_DOWN_SCALE,    // `down_scale_image`
+    PERF_FORMAT,        // `format_image`
+    PERF_BRICK,         // one brick of `print_printer`
+    PERF_MOTION,        // the motion program placing the brick
+    PERF_RENDER,        // drawing the printing screen
+    PERF_SWAP,          // swapping the buffers
+    NUM_PERF_SCOPES,
+};
+
+// Starts timing `scope` until the matching PERF_END (in the same block)
+#define PERF_BEGIN(scope) unsigned long perf_begin_##scope = hal_cycles()
+#define PERF_END(scope) perf_record(scope, perf_begin_##scope)
+
+/*
+ * `perf_record`
+ *
+ * Adds the cycles from `start` until now to `scope`.
+ *
+ * @param scope       the scope to add to
+ * @param start       `hal_cycles()` when the scope was entered
+ */
+void perf_record(enum perf_scope scope, unsigned long start);
+
+/*
+ * `perf_reset`
+ *
+ * Forgets every timing recorded so far.
+ */
+void perf_reset(void);
+
+/*
+ * `perf_draw`
+ *
+ * Draws the average, min and max time of every scope entered so far (in milliseconds), with the top left
+ * corner at {x, y}, on the current draw buffer.
+ *
+ * @param x           the left edge of the overlay
+ * @param y           the top edge of the overlay
+ */
+void perf_draw(int x, int y);
+
+/*
+ * `perf_height`
+ *
+ * @return            the height of the overlay in pixels
+ */
+int perf_height(void);
+
+#endif
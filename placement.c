@@ -0,0 +1,106 @@
+/* File: placement.c
+ * =-=-=-=-=-=-=-=-=
+ * Builds the placement list of a print job from its formatted image.
+ */
+
+// Library Imports
+#include "gl.h"
+#include "malloc.h"
+#include "strings.h"
+
+// Project Imports
+#include "placement.h"
+
+// Constants
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+/* Function: placement_build()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Counts the bricks of the job, then fills in one entry per brick and
+ * the demand on each cartridge.
+ */
+struct placement_list* placement_build(const struct img *quantized, const struct printer *color_map) {
+    unsigned int count = 0;
+    for(int i = 0; i < quantized->width * quantized->height; i++) {
+        if(quantized->pixels[i] != GL_BLACK) count++;
+    }
+
+    struct placement_list *list = malloc(sizeof(struct placement_list) + count * sizeof(struct placement));
+    list->color_map = color_map;
+    list->width = quantized->width;
+    list->height = quantized->height;
+    list->count = 0;
+    for(int c = 0; c < PLACEMENT_MAX_CARTRIDGES; c++) list->demand[c] = 0;
+
+    for(int i = 0; i < quantized->width * quantized->height; i++) {
+        if(quantized->pixels[i] == GL_BLACK) continue;
+
+        int c = cartridge_index(color_map, quantized->pixels[i]);
+        if(c < 0 || c >= PLACEMENT_MAX_CARTRIDGES) c = PLACEMENT_NO_CARTRIDGE;
+        else list->demand[c]++;
+
+        struct placement *brick = &list->bricks[list->count++];
+        brick->x = i % quantized->width;
+        brick->y = i / quantized->width;
+        brick->cartridge = c;
+    }
+    return list;
+}
+
+/* Function: placement_copy()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Copies the header and the packed bricks in one block, followed by a
+ * copy of the color map (the cartridges drawing their bricks from the
+ * stock of the originals, like the picks of the AUTO color map do).
+ */
+struct placement_list* placement_copy(const struct placement_list *list) {
+    unsigned int size = sizeof(struct placement_list) + list->count * sizeof(struct placement);
+    unsigned int map_at = (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+    unsigned int num_cartridges = list->color_map->num_cartridges;
+    struct placement_list *copy = malloc(map_at + sizeof(struct printer) + num_cartridges * sizeof(struct cartridge));
+    memcpy(copy, list, size);
+
+    struct printer *color_map = (struct printer *)((char *)copy + map_at);
+    struct cartridge *cartridges = (struct cartridge *)(color_map + 1);
+    for(unsigned int c = 0; c < num_cartridges; c++) {
+        struct cartridge *original = &list->color_map->list_cartridges[c];
+        cartridges[c] = *original;
+        cartridges[c].reserved = 0;
+        cartridges[c].stock = original->stock ? original->stock : original;
+    }
+    color_map->num_cartridges = num_cartridges;
+    color_map->list_cartridges = cartridges;
+    color_map->name_printer = list->color_map->name_printer;
+    copy->color_map = color_map;
+    return copy;
+}
+
+/* Function: placement_free()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Frees a placement list.
+ */
+void placement_free(struct placement_list *list) {
+    free(list);
+}
+
+/* Function: placement_checksum()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Hashes the packed bricks of a list.
+ */
+unsigned int placement_checksum(const struct placement_list *list) {
+    unsigned int hash = FNV_OFFSET;
+    const unsigned char *bricks = (const unsigned char *)list->bricks;
+    for(int i = 0; i < list->count * sizeof(struct placement); i++) hash = (hash ^ bricks[i]) * FNV_PRIME;
+    return hash;
+}
+
+/* Function: placement_color()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Looks the color of a brick up through its cartridge.
+ */
+unsigned int placement_color(const struct placement_list *list, unsigned int brick) {
+    unsigned int c = list->bricks[brick].cartridge;
+    if(c == PLACEMENT_NO_CARTRIDGE) return GL_WHITE;
+    return list->color_map->list_cartridges[c].color;
+}
@@ -0,0 +1,94 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/*
+ * Placement lists: the representation of a print job. A job is built
+ * once from the image formatted to its color map, as a packed array of
+ * the bricks to place in the order they are placed (the stud of each
+ * brick and the cartridge it comes from), along with the number of
+ * bricks each cartridge gives. Compiling, estimating, planning the
+ * feeder and drawing the print all work from the list, so nothing after
+ * it scans the image again.
+ */
+
+// Project Imports
+#include "bitmaps.h"
+#include "colormaps.h"
+
+// Constants
+#define PLACEMENT_MAX_CARTRIDGES 30
+#define PLACEMENT_NO_CARTRIDGE 0xff
+
+// One brick of a job: the stud it goes on, and the cartridge it comes from (PLACEMENT_NO_CARTRIDGE if the
+// color map has no cartridge of its color)
+struct placement {
+    unsigned char x, y, cartridge;
+};
+
+// Contains the `bricks` of a job in placement order, the `demand` on each cartridge, and the job's size in studs
+struct placement_list {
+    const struct printer *color_map;
+    unsigned int width, height;
+    unsigned int count;
+    unsigned int demand[PLACEMENT_MAX_CARTRIDGES];
+    struct placement bricks[];
+};
+
+/*
+ * `placement_build`
+ *
+ * Builds the placement list of an image formatted to `color_map`: one brick per non-black pixel,
+ * in row order.
+ *
+ * @param quantized   the image formatted to `color_map` (one pixel per brick, at most 255x255)
+ * @param color_map   the color map the image was formatted to
+ *
+ * @return            the list as type struct placement_list* (free with `placement_free`)
+ */
+struct placement_list* placement_build(const struct img *quantized, const struct printer *color_map);
+
+/*
+ * `placement_copy`
+ *
+ * Copies a placement list, along with its color map: the copy keeps the colors (and stocks) of its cartridges
+ * when the color map is refilled (as the AUTO one is for every job).
+ *
+ * @param list        the list to copy
+ *
+ * @return            the copy as type struct placement_list* (free with `placement_free`)
+ */
+struct placement_list* placement_copy(const struct placement_list *list);
+
+/*
+ * `placement_free`
+ *
+ * Frees a list returned by `placement_build` or `placement_copy`.
+ *
+ * @param list        the list to free
+ */
+void placement_free(struct placement_list *list);
+
+/*
+ * `placement_checksum`
+ *
+ * Returns a checksum (FNV-1a) of the bricks of a list, for telling jobs apart.
+ *
+ * @param list        the list to checksum
+ *
+ * @return            the checksum
+ */
+unsigned int placement_checksum(const struct placement_list *list);
+
+/*
+ * `placement_color`
+ *
+ * Returns the color of a brick of a list (white if its color map has no cartridge for it).
+ *
+ * @param list        the list the brick belongs to
+ * @param brick       the index of the brick
+ *
+ * @return            the color of the brick
+ */
+unsigned int placement_color(const struct placement_list *list, unsigned int brick);
+
+#endif
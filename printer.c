@@ -24,10 +24,23 @@
 // Project Imports
 #include "printer.h"
 #include "bitmaps.h"
+#include "checkpoint.h"
 #include "colormaps.h"
+#include "feeder_layout.h"
+#include "heap.h"
+#include "hal.h"
 #include "img_process.h"
+#include "input_log.h"
+#include "inventory.h"
+#include "isr_stats.h"
+#include "kinematics.h"
+#include "motion_program.h"
+#include "perf.h"
+#include "placement.h"
 #include "printer_assets.h"
 #include "printer_driver.h"
+#include "profile.h"
+#include "trace.h"
 
 // Scene Modes
 #define MODE_TITLE -2
@@ -38,8 +51,11 @@
 
 // Preview Mode Indices
 #define COLOR_MODE 0
-#define SCALE_MODE 1
-#define PRINT_MODE 2
+#define DITHER_MODE 1
+#define SCALE_MODE 2
+#define PRINT_MODE 3
+#define RESUME_FROM 4
+#define RESUME_TO 5
 #define MENU_SIZE 13
 
 // Scale Mode Indices 
@@ -65,10 +81,15 @@
 // Constants
 #define MAX_COLORS 30
 #define KEEP_TRACK_OF_LEGOS true // !! IMPORTANT -> (change to false to stop keeping track of LEGOs)
-#define BACKGROUND_REMOVAL true // !! IMPORTANT  -> (change to false to disable image background removal feature)
-#define COLOR_X 700
-#define COLOR_Y 3500
-#define COLOR_X_OFFSET 4000
+#define DUMP_MOTION_PROGRAM false // !! IMPORTANT -> (change to true to print each job's motion program over UART)
+#define APPLY_FEEDER_LAYOUT false // !! IMPORTANT -> (change to true once cartridges are loaded in the recommended feeder slots)
+#define LOADED_FEEDER_SLOTS 9 // !! IMPORTANT -> (number of feeder slots loaded, the AUTO color map picks that many cartridges, at most AUTO_MAX_CARTRIDGES)
+#define SAMPLE_PROFILER false // !! IMPORTANT -> (change to true to sample where the CPU spends its time, PROFILE_KEY dumps the samples over UART)
+#define DEBUG_DUMPS false // !! IMPORTANT -> (change to true for HEAP_KEY and INPUT_KEY to dump the heap use and the keys pressed over UART)
+#define PROFILE_KEY 'p'
+#define PERF_KEY 'o'
+#define HEAP_KEY 'h'
+#define INPUT_KEY 'i'
 #define CHAR_LIM 1024
 
 // Global Variables
@@ -78,9 +99,20 @@ unsigned int bmp_index = 0;
 unsigned int idx_offset = 0;
 unsigned int preview_menu_index = 0;
 unsigned int printer_index = 0;
+unsigned int dither_index = DITHER_NONE;
 unsigned int scale_index = 0;
 unsigned int image_index = 0;
-struct img** curr_print;
+struct img* curr_print = NULL;
+struct feeder_layout layout;
+bool resumable = false;
+bool resuming = false;
+unsigned int resume_from = 0;
+unsigned int resume_to = 0;
+bool perf_overlay = false;
+struct colormap_ranking ranking;
+int ranked_bmp = -1;
+int ranked_scale = -1;
+bool printer_chosen = false;
 
 // Module-level global variables for printer
 static struct {
@@ -95,9 +127,10 @@ static struct {
 void printer_init(input_fn_t read_fn) {
     // Printer initialization
     module.printer_read = read_fn;	
-    const int height = 20 * (gl_get_char_height() + 5);
+    const int height = 24 * (gl_get_char_height() + 5);
     const int width = 40 * gl_get_char_width();
     gl_init(width, height, GL_DOUBLEBUFFER);
+    profile_enable(SAMPLE_PROFILER);
 }
 
 /* Function: print_title()
@@ -106,7 +139,7 @@ void printer_init(input_fn_t read_fn) {
  * printer application. Switches scenes on ENTER press.
  */
 void print_title(void) {
-    if(mode == MODE_TITLE) display_image((const struct img*)&title, 0, 0, gl_get_width(), gl_get_height(), false, 0);
+    if(mode == MODE_TITLE) display_image((const struct img*)&title, 0, 0, title.width, title.height, false, 0);
 }
 
 /* Function: print_header()
@@ -207,6 +240,102 @@ void print_menu(void) {
     }
 }
 
+/* Function: print_resume_item()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Displays one end of the resume range at height `y`, highlighted
+ * when it is the selected preview menu item.
+ */
+static void print_resume_item(const char *label, unsigned int value, unsigned int index, unsigned int y) {
+    char value_str[CHAR_LIM];
+    num_to_string(value_str, CHAR_LIM, value, 10, 3);
+    unsigned int x = 295 + strlen(label) * gl_get_char_width();
+    gl_draw_string(295, y, label, GL_WHITE);
+    if(preview_menu_index == index && mode == MODE_PREVIEW) {
+        gl_draw_rect(x - 1, y - 1, strlen(value_str)*gl_get_char_width() + 2, gl_get_char_height() + 2, GL_WHITE);
+        gl_draw_string(x, y, value_str, GL_BLACK);
+    }
+    else gl_draw_string(x, y, value_str, GL_WHITE);
+    gl_draw_string(x + strlen(value_str)*gl_get_char_width(), y, ">", GL_WHITE);
+}
+
+/* Function: job_image()
+ * =-=-=-=-=-=-=-=-=-=-=-
+ * Returns the image printed in the selected scale mode: the whole image
+ * at 20x20, or a quarter of it scaled to 40x40.
+ */
+static struct img* job_image(void) {
+    const struct scale_mode *scale = SCALE_MODE_LIST[scale_index];
+    return down_scale_crop_image(BITMAP_LIST[bmp_index], scale->scale, scale->x_start, scale->y_start, scale->width, scale->height);
+}
+
+/* Function: rank_colormaps()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Picks the cartridges of the AUTO color map for the selected image and
+ * scale out of the full default blue palette, then ranks the color maps,
+ * once per change of either. Follows the best one until a color map is
+ * picked by hand.
+ */
+static void rank_colormaps(void) {
+    if(ranked_bmp != bmp_index || ranked_scale != scale_index) {
+        struct img *job = job_image();
+        palette_select(job, &P_DEFAULT_BLUE, LOADED_FEEDER_SLOTS, &P_AUTO);
+        colormap_rank(job, PRINTER_LIST, NUM_PRINTERS, &ranking);
+        free(job);
+        ranked_bmp = bmp_index;
+        ranked_scale = scale_index;
+    }
+    if(!printer_chosen) printer_index = ranking.scores[0].printer;
+}
+
+/* Function: print_ranking()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Displays the ranked color maps under the menu: the mean error per
+ * pixel matched, and whether the cartridges cover the job (or how many
+ * bricks they fall short by). The selected color map is highlighted.
+ */
+static void print_ranking(void) {
+    int y = 15 + (2 * gl_get_char_height()) + MENU_SIZE * (gl_get_char_height() + 12) - 4;
+    gl_draw_string(5, y, "COLORMAP ERR  FIT", GL_AMBER);
+    for(int r = 0; r < ranking.num_scores; r++) {
+        const struct colormap_score *score = &ranking.scores[r];
+        char rank_str[CHAR_LIM], error_str[CHAR_LIM], fit_str[CHAR_LIM];
+        int row = y + (r + 1) * gl_get_char_height();
+
+        snprintf(rank_str, CHAR_LIM, "%d %s", r + 1, PRINTER_LIST[score->printer]->name_printer);
+        if(score->matched) snprintf(error_str, CHAR_LIM, "%d", (int)(score->error / score->matched));
+        else snprintf(error_str, CHAR_LIM, "-");
+        if(score->shortfall) snprintf(fit_str, CHAR_LIM, "-%d", score->shortfall);
+        else snprintf(fit_str, CHAR_LIM, "OK");
+
+        if(score->printer == printer_index) {
+            gl_draw_rect(4, row - 1, strlen(rank_str)*gl_get_char_width() + 2, gl_get_char_height() + 2, GL_WHITE);
+            gl_draw_string(5, row, rank_str, GL_BLACK);
+        }
+        else gl_draw_string(5, row, rank_str, GL_WHITE);
+        gl_draw_string(5 + 9 * gl_get_char_width(), row, error_str, GL_WHITE);
+        gl_draw_string(5 + 14 * gl_get_char_width(), row, fit_str, score->shortfall ? GL_RED : GL_MOSS);
+    }
+}
+
+/* Function: print_overlay()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Displays the timings overlay in the bottom left corner, with the
+ * stepper interrupt stats of the current (or last) print above it.
+ */
+static void print_overlay(void) {
+    const volatile struct isr_stats *isr = isr_stats_get();
+    unsigned long late_ns = isr_stats_ns(isr->max_late), run_ns = isr_stats_ns(isr->max_duration);
+    char isr_str[CHAR_LIM];
+    int y = gl_get_height() - perf_height() - 2 * gl_get_char_height();
+
+    gl_draw_rect(0, y, 32 * gl_get_char_width() + 4, 2 * gl_get_char_height(), GL_BLACK);
+    snprintf(isr_str, CHAR_LIM, "ISR LATE %ld.%ld RUN %ld.%ld US", late_ns / 1000, late_ns / 100 % 10, run_ns / 1000, run_ns / 100 % 10);
+    gl_draw_string(2, y, isr_str, GL_WHITE);
+    snprintf(isr_str, CHAR_LIM, "MISSED %ld OVERRUNS %ld", isr->missed, isr->overruns);
+    gl_draw_string(2, y + gl_get_char_height(), isr_str, (isr->missed || isr->overruns) ? GL_RED : GL_WHITE);
+    perf_draw(0, gl_get_height() - perf_height());
+}
+
 /* Function: print_preview()
  * =-=-=-=-=-=-=-=-=-=-=-
  * Displays preview portion on SELECTION screen. Allows user
@@ -215,9 +344,15 @@ void print_menu(void) {
  */
 void print_preview(void) {
     if(mode > MODE_TITLE && mode < MODE_PRINTING) {
+        PERF_BEGIN(PERF_PREVIEW);
+        rank_colormaps();
+
         // Set default preview to 80x80 version of image
-        struct img *init_down_scale = down_scale_image(BITMAP_LIST[bmp_index], 80, 80);
-        init_down_scale = format_image(init_down_scale, *PRINTER_LIST[printer_index], false);
+        unsigned long estimate_us = 0;
+        resumable = false;
+        struct img *preview = down_scale_image(BITMAP_LIST[bmp_index], 80, 80);
+        struct img *init_down_scale = format_image_dithered(preview, PRINTER_LIST[printer_index], false, dither_index);
+        free(preview);
         // Scale up by factor of 3 to make the image 240x240 (but still look 80x80)
         struct img *curr_scaled = up_scale_image(init_down_scale, 3, 3);
 
@@ -228,48 +363,62 @@ void print_preview(void) {
             free(curr_scaled);
 
             // Check scale modes, and adjust image accordingly
-            if(scale_index == TWNTY) init_down_scale = down_scale_image(BITMAP_LIST[bmp_index], 20, 20);
-            else {
-                if(scale_index == FRTY_TL) init_down_scale = crop_image((const struct img*)down_scale_image(BITMAP_LIST[bmp_index], 40, 40), 0, 0, 20, 20);
-                if(scale_index == FRTY_TR)init_down_scale = crop_image((const struct img*)down_scale_image(BITMAP_LIST[bmp_index], 40, 40), 20, 0, 20, 20);
-                if(scale_index == FRTY_BL)init_down_scale = crop_image((const struct img*)down_scale_image(BITMAP_LIST[bmp_index], 40, 40), 0, 20, 20, 20);
-                if(scale_index == FRTY_BR)init_down_scale = crop_image((const struct img*)down_scale_image(BITMAP_LIST[bmp_index], 40, 40), 20, 20, 20, 20);
-            }
-
-            // Format image to correct color map and scale up to 240x240 (but still look 20x20)
-            curr_scaled = format_image(init_down_scale, *PRINTER_LIST[printer_index], KEEP_TRACK_OF_LEGOS);        
-            curr_scaled = up_scale_image(curr_scaled, 12, 12);
+            init_down_scale = job_image();
+
+            // Format image to correct color map, plan the feeder for it, and scale up to 240x240 (but still look 20x20)
+            struct img *quantized = format_image_dithered(init_down_scale, PRINTER_LIST[printer_index], KEEP_TRACK_OF_LEGOS, dither_index);
+            struct placement_list *job = placement_build(quantized, PRINTER_LIST[printer_index]);
+            feeder_plan(job, &layout);
+            resumable = checkpoint_matches(&checkpoint, bmp_index, printer_index, scale_index);
+            curr_scaled = up_scale_image(quantized, 12, 12);
+            free(quantized);
+
+            // Estimate how long the print takes (compiling the job now also caches it for printing)
+            estimate_us = program_estimate(program_cache_get(bmp_index, printer_index, scale_index, job), NULL);
+            placement_free(job);
         }
 
         // Display preview of image print along with white border around it
         gl_draw_rect(293, 18 + (2 * gl_get_char_height()), 244, 244, GL_WHITE);
         display_image(curr_scaled, 295, 20 + (2 * gl_get_char_height()), 240, 240, false, 0);
 
-        // Set current image global to current selected image
-        *curr_print = curr_scaled;
+        // Set current image global to current selected image (replacing the one from the last frame)
+        free(curr_print);
+        curr_print = curr_scaled;
         free(init_down_scale);
 
         // Color mode menu under image on preview tab
-        gl_draw_string(295, 268 + (5 * gl_get_char_height() / 2), "COLORMODE:<", GL_WHITE);
+        gl_draw_string(295, 268 + (2 * gl_get_char_height()), "COLORMODE:<", GL_WHITE);
         const char* printer_name = PRINTER_LIST[printer_index]->name_printer;
         unsigned int printer_name_offset = (5 - strlen(printer_name)) * gl_get_char_width() / 2;
         if(preview_menu_index == COLOR_MODE && mode == MODE_PREVIEW){
-            gl_draw_rect(295 + strlen("COLORMODE:<")*gl_get_char_width() + printer_name_offset - 1, 268 + (5 * gl_get_char_height() / 2) - 1, strlen(printer_name)*gl_get_char_width() + 2, gl_get_char_height() + 2, GL_WHITE);
-            gl_draw_string(295 + strlen("COLORMODE:<")*gl_get_char_width() + printer_name_offset, 268 + (5 * gl_get_char_height() / 2), printer_name, GL_BLACK);
+            gl_draw_rect(295 + strlen("COLORMODE:<")*gl_get_char_width() + printer_name_offset - 1, 268 + (2 * gl_get_char_height()) - 1, strlen(printer_name)*gl_get_char_width() + 2, gl_get_char_height() + 2, GL_WHITE);
+            gl_draw_string(295 + strlen("COLORMODE:<")*gl_get_char_width() + printer_name_offset, 268 + (2 * gl_get_char_height()), printer_name, GL_BLACK);
         }
-        else gl_draw_string(295 + strlen("COLORMODE:<")*gl_get_char_width() + printer_name_offset, 268 + (5 * gl_get_char_height() / 2), printer_name, GL_WHITE);
-        gl_draw_string(295 + strlen("COLORMODE:<_____")*gl_get_char_width(), 268 + (5 * gl_get_char_height() / 2), ">", GL_WHITE);
+        else gl_draw_string(295 + strlen("COLORMODE:<")*gl_get_char_width() + printer_name_offset, 268 + (2 * gl_get_char_height()), printer_name, GL_WHITE);
+        gl_draw_string(295 + strlen("COLORMODE:<_____")*gl_get_char_width(), 268 + (2 * gl_get_char_height()), ">", GL_WHITE);
+
+        // Dithering mode menu under color mode on preview tab
+        gl_draw_string(295, 268 + (13 * gl_get_char_height() / 4), "DITHERING:<", GL_WHITE);
+        const char* dither_name = DITHER_NAMES[dither_index];
+        unsigned int dither_name_offset = (5 - strlen(dither_name)) * gl_get_char_width() / 2;
+        if(preview_menu_index == DITHER_MODE && mode == MODE_PREVIEW){
+            gl_draw_rect(295 + strlen("DITHERING:<")*gl_get_char_width() + dither_name_offset - 1, 268 + (13 * gl_get_char_height() / 4) - 1, strlen(dither_name)*gl_get_char_width() + 2, gl_get_char_height() + 2, GL_WHITE);
+            gl_draw_string(295 + strlen("DITHERING:<")*gl_get_char_width() + dither_name_offset, 268 + (13 * gl_get_char_height() / 4), dither_name, GL_BLACK);
+        }
+        else gl_draw_string(295 + strlen("DITHERING:<")*gl_get_char_width() + dither_name_offset, 268 + (13 * gl_get_char_height() / 4), dither_name, GL_WHITE);
+        gl_draw_string(295 + strlen("DITHERING:<_____")*gl_get_char_width(), 268 + (13 * gl_get_char_height() / 4), ">", GL_WHITE);
 
         // Scale mode menu under image on preview tab
-        gl_draw_string(295, 268 + (4 * gl_get_char_height()) + 4, "SCALEMODE:<", GL_WHITE);
+        gl_draw_string(295, 268 + (9 * gl_get_char_height() / 2), "SCALEMODE:<", GL_WHITE);
         const char* scale_name = SCALE_MODE_LIST[scale_index]->name;
         unsigned int scale_name_offset = (5 - strlen(scale_name)) * gl_get_char_width() / 2;
         if(preview_menu_index == SCALE_MODE && mode == MODE_PREVIEW){
-            gl_draw_rect(295 + strlen("SCALEMODE:<")*gl_get_char_width() + scale_name_offset - 1, 268 + (4 * gl_get_char_height()) + 4 - 1, strlen(scale_name)*gl_get_char_width() + 2, gl_get_char_height() + 2, GL_WHITE);
-            gl_draw_string(295 + strlen("SCALEMODE:<")*gl_get_char_width() + scale_name_offset, 268 + (4 * gl_get_char_height()) + 4, scale_name, GL_BLACK);
+            gl_draw_rect(295 + strlen("SCALEMODE:<")*gl_get_char_width() + scale_name_offset - 1, 268 + (9 * gl_get_char_height() / 2) - 1, strlen(scale_name)*gl_get_char_width() + 2, gl_get_char_height() + 2, GL_WHITE);
+            gl_draw_string(295 + strlen("SCALEMODE:<")*gl_get_char_width() + scale_name_offset, 268 + (9 * gl_get_char_height() / 2), scale_name, GL_BLACK);
         }
-        else gl_draw_string(295 + strlen("SCALEMODE:<")*gl_get_char_width() + scale_name_offset, 268 + (4 * gl_get_char_height()) + 4, scale_name, GL_WHITE);
-        gl_draw_string(295 + strlen("SCALEMODE:<_____")*gl_get_char_width(), 268 + (4 * gl_get_char_height()) + 4, ">", GL_WHITE);
+        else gl_draw_string(295 + strlen("SCALEMODE:<")*gl_get_char_width() + scale_name_offset, 268 + (9 * gl_get_char_height() / 2), scale_name, GL_WHITE);
+        gl_draw_string(295 + strlen("SCALEMODE:<_____")*gl_get_char_width(), 268 + (9 * gl_get_char_height() / 2), ">", GL_WHITE);
 
         // Print button under image on preview tab
         unsigned int TEXT_COLOR = GL_WHITE;
@@ -279,9 +428,47 @@ void print_preview(void) {
         }
         else gl_draw_rect(gl_get_width() / 4 * 3 - strlen("PRINT")*gl_get_char_width() / 2 - 8, 268 + (13 * gl_get_char_height() / 2) - 3, strlen("PRINT")*gl_get_char_width() + 14, gl_get_char_height() + 12, GL_BLACK);
         gl_draw_string(gl_get_width() / 4 * 3 - strlen("PRINT")*gl_get_char_width() / 2, 268 + (13 * gl_get_char_height() / 2) + 4, "PRINT", TEXT_COLOR);
+
+        // Estimated print time, and travel saved by loading the feeder in the recommended layout (print scales only)
+        if(scale_index != PREV) {
+            char estimate_str[CHAR_LIM];
+            duration_to_string(estimate_str, CHAR_LIM, estimate_us / 1000000);
+            gl_draw_string(295, 268 + (9 * gl_get_char_height()), "EST TIME:", GL_WHITE);
+            gl_draw_string(295 + strlen("EST TIME:")*gl_get_char_width(), 268 + (9 * gl_get_char_height()), estimate_str, GL_MOSS);
+
+            char saving_str[CHAR_LIM];
+            unsigned long saving = feeder_saving(&layout);
+            num_to_string(saving_str, CHAR_LIM, saving, 10, 1);
+            strlcat(saving_str, "%", CHAR_LIM);
+            gl_draw_string(295, 268 + (21 * gl_get_char_height() / 2), "FEEDER SAVING:", GL_WHITE);
+            gl_draw_string(295 + strlen("FEEDER SAVING:")*gl_get_char_width(), 268 + (21 * gl_get_char_height() / 2), saving_str, GL_MOSS);
+        }
+
+        // Range of bricks to resume (or place again) if this job was printed before
+        if(resumable) {
+            print_resume_item("RESUME FROM:<", resume_from, RESUME_FROM, 268 + (12 * gl_get_char_height()));
+            print_resume_item("RESUME TO:  <", resume_to, RESUME_TO, 268 + (27 * gl_get_char_height() / 2));
+        }
+        else if(preview_menu_index > PRINT_MODE) preview_menu_index = PRINT_MODE;
+        print_ranking();
+        PERF_END(PERF_PREVIEW);
     }
 }
 
+/* Function: print_refused()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=
+ * Displays why a print did not start in place of the PRINTING screen
+ * (any key goes back to the preview).
+ */
+static void print_refused(const char *reason, const char *detail) {
+    gl_clear(GL_BLACK);
+    gl_draw_string(gl_get_width() / 2 - strlen("PRINT NOT STARTED")*gl_get_char_width() / 2, 10, "PRINT NOT STARTED", GL_RED);
+    gl_draw_string(gl_get_width() / 2 - strlen(reason)*gl_get_char_width() / 2, 10 + 3 * gl_get_char_height(), reason, GL_WHITE);
+    gl_draw_string(gl_get_width() / 2 - strlen(detail)*gl_get_char_width() / 2, 10 + 5 * gl_get_char_height(), detail, GL_WHITE);
+    gl_draw_string(gl_get_width() / 2 - strlen("PRESS ANY KEY")*gl_get_char_width() / 2, 10 + 8 * gl_get_char_height(), "PRESS ANY KEY", GL_AMBER);
+    printf("Print not started: %s (%s)\n", reason, detail);
+}
+
 /* Function: print_printer()
  * =-=-=-=-=-=-=-=-=-=-=-
  * Displays PRINTING screen, with live print of selected
@@ -290,68 +477,104 @@ void print_preview(void) {
 void print_printer(void) {
     if(mode == MODE_PRINTING) {
         // Realtime printer display dimensions
-        unsigned int width = 20;
-        unsigned int height = 20;
         unsigned int up_scale = 300;
 
-        // Downscale image to 20x20 mode as default, if not, check for the different 40x40 modes
-        struct img *down_scale = down_scale_image(BITMAP_LIST[bmp_index], 20, 20);
-        if(scale_index != TWNTY) {
-            free(down_scale);
-            if(scale_index == FRTY_TL)down_scale = crop_image((const struct img*)down_scale_image(BITMAP_LIST[bmp_index], 40, 40), 0, 0, 20, 20);
-            if(scale_index == FRTY_TR)down_scale = crop_image((const struct img*)down_scale_image(BITMAP_LIST[bmp_index], 40, 40), 20, 0, 20, 20);
-            if(scale_index == FRTY_BL)down_scale = crop_image((const struct img*)down_scale_image(BITMAP_LIST[bmp_index], 40, 40), 0, 20, 20, 20);
-            if(scale_index == FRTY_BR)down_scale = crop_image((const struct img*)down_scale_image(BITMAP_LIST[bmp_index], 40, 40), 20, 20, 20, 20);
+        // A resume places bricks of the job the checkpoint kept (the half-built print), never a job quantized again
+        bool resume = resuming;
+        resuming = false;
+        struct placement_list *job;
+        unsigned int first = 0, last;
+        if(resume) {
+            if(!checkpoint_matches(&checkpoint, bmp_index, printer_index, scale_index)) {
+                print_refused("NOTHING TO RESUME", "SELECTION HAS NO CHECKPOINT");
+                return;
+            }
+            job = checkpoint.job;
+            first = resume_from;
+            last = resume_to;
         }
+        else {
+            // Downscale image to 20x20 mode as default, if not, check for the different 40x40 modes
+            struct img *down_scale = job_image();
 
-        // Format image to selected color map
-        struct img *temp = format_image((const struct img*)down_scale, *PRINTER_LIST[printer_index], true);
-        free(down_scale);
-        down_scale = temp;
-
-        // Home printer back to 0,0
-        home_steppers();
-
-        // Printing of image using LEGOs, executes program on LEGONARDO DAVINCI machine and then prints printed piece to screen
-        for(int i = 0; i < width * height && mode == MODE_PRINTING; i++) {
-
-            // Removes black background from images (to save LEGO pieces)
-            if(BACKGROUND_REMOVAL && ((down_scale->pixels[i] == GL_BLACK))) continue;
+            // Format image to selected color map, and turn it into the list of bricks to place
+            struct img *temp = format_image_dithered((const struct img*)down_scale, PRINTER_LIST[printer_index], KEEP_TRACK_OF_LEGOS, dither_index);
+            free(down_scale);
+            job = placement_build(temp, PRINTER_LIST[printer_index]);
+            free(temp);
+            last = job->count;
+        }
 
-            // Determine offset for color pick-up
-            unsigned int offset = 0;
-            for(int j = 0; j < PRINTER_LIST[printer_index]->num_cartridges; j++) {
-                if(PRINTER_LIST[printer_index]->list_cartridges[j].color == down_scale->pixels[i]) {
-                    offset = j;
-                    break;
-                }   
-            }
+        // Hold back the bricks the run places before anything starts (it only starts if they are all there, and a
+        // refused job leaves the checkpoint of the last one alone)
+        struct reservation reservation;
+        if(KEEP_TRACK_OF_LEGOS && !inventory_reserve(&reservation, job, first, last)) {
+            unsigned int worst = 0;
+            unsigned int short_by = inventory_shortfall(job, first, last, &worst);
+            char detail[CHAR_LIM];
+            snprintf(detail, CHAR_LIM, "%d SHORT, MOST IN CARTRIDGE %d", short_by, worst + 1);
+            print_refused("NOT ENOUGH BRICKS", detail);
+            if(!resume) placement_free(job);
+            return;
+        }
 
-            // Move printer to color, pick up color, move to pixel location, place pixel
-            coordinate color_pickup;
-            color_pickup.x = COLOR_X + (COLOR_X_OFFSET * offset);
-            color_pickup.y = COLOR_Y;
-            pick_and_place(i % 20, i / 20, color_pickup);
+        // Plan the feeder layout, only picking up from the planned slots if the feeder was loaded that way
+        feeder_plan(job, &layout);
+        if(APPLY_FEEDER_LAYOUT) feeder_apply(&layout);
+        else feeder_reset();
+
+        // Compile the job into a motion program: a new print starts a fresh checkpoint and reuses the cached program if
+        // nothing changed, a resume only compiles the range of bricks it places
+        struct motion_program *resume_program = NULL;
+        const struct motion_program *program;
+        if(resume) program = resume_program = program_compile_range(job, first, last);
+        else {
+            checkpoint_start(&checkpoint, bmp_index, printer_index, scale_index, job);
+            program = program_cache_get(bmp_index, printer_index, scale_index, job);
+        }
+        if(DUMP_MOTION_PROGRAM) program_dump(program);
+
+        // Predicted time each brick gets placed at, corrected on the fly by how long the placed bricks really took
+        unsigned long *progress_us = malloc((program->bricks + 1) * sizeof(unsigned long));
+        unsigned long estimate_ms = program_estimate(program, progress_us) / 1000;
+        unsigned long start_us = hal_time_us();
+        isr_stats_reset(STEPPER_TICK_US);
+        unsigned int placed = 0;
+
+        // Printing of image using LEGOs, streams the program (which homes first) to the LEGONARDO DAVINCI machine 
+        // and prints each placed piece to screen
+        unsigned int pc = 0;
+        int i = 0;
+        unsigned long brick_start = hal_cycles();
+        while(mode == MODE_PRINTING && (i = program_run(program, &pc)) >= 0) {
+            perf_record(PERF_MOTION, brick_start);
+            PERF_BEGIN(PERF_RENDER);
+
+            // Brick `i` is down, take it out of its cartridge and record it in the checkpoint
+            if(KEEP_TRACK_OF_LEGOS) inventory_commit(&reservation, job->bricks[i].cartridge);
+            checkpoint_placed(&checkpoint, job, i, axis_position(AXIS_X), axis_position(AXIS_Y), axis_position(AXIS_Z));
+            isr_stats_trace();
+
+            // Time left, scaling the rest of the estimate by how far off it has been so far
+            unsigned long elapsed_ms = (hal_time_us() - start_us) / 1000;
+            unsigned long planned_ms = progress_us[placed++] / 1000;
+            unsigned long eta_ms = estimate_ms - planned_ms;
+            if(planned_ms) eta_ms = eta_ms * elapsed_ms / planned_ms;
 
             // Realtime print section of screen
             gl_clear(GL_BLACK);
             gl_draw_string(309 / 2 - strlen("REALTIME PRINT")*gl_get_char_width() / 2, 10, "REALTIME PRINT", GL_AMBER);
             gl_draw_rect(5, 10 + gl_get_char_height() * 3 / 2, 304, 304, GL_WHITE);
             gl_draw_rect(7, 12 + gl_get_char_height() * 3 / 2, 300, 300, GL_BLACK);
-            for(int j = 0; j <= i; j++) {
-                
-                // !!! DELETE IF BROKEN - BETA FEATURE
-                if(BACKGROUND_REMOVAL && ((down_scale->pixels[j] == GL_BLACK))) continue;
-                // !!! DELETE IF BROKEN - BETA FEATURE
-
-                unsigned int x_pos = j % width * up_scale / width;
-                unsigned int y_pos = j / width * up_scale / height;
-                gl_draw_rect(7 + x_pos, 12 + gl_get_char_height() * 3 / 2 + y_pos, up_scale / width, up_scale / height, down_scale->pixels[j]);
+            for(int j = 0; j < checkpoint.next; j++) {
+                unsigned int x_pos = job->bricks[j].x * up_scale / job->width;
+                unsigned int y_pos = job->bricks[j].y * up_scale / job->height;
+                gl_draw_rect(7 + x_pos, 12 + gl_get_char_height() * 3 / 2 + y_pos, up_scale / job->width, up_scale / job->height, placement_color(job, j));
             }
 
-            // Calculating percent of image printed, and converting to string
+            // Calculating percent of bricks placed (out of the bricks this run places), and converting to string
             char percent_str[CHAR_LIM];    
-            unsigned long percent = (1 + i) * 100 / (width * height);
+            unsigned long percent = placed * 100 / program->bricks;
             if(!percent) {
                 percent_str[0] = '0';
                 percent_str[1] = '\0';
@@ -366,18 +589,24 @@ void print_printer(void) {
             gl_draw_rect(9, 332 + gl_get_char_height() * 7 / 2, 296, 28, GL_BLACK);
             gl_draw_rect(9, 332 + gl_get_char_height() * 7 / 2, 296 * percent / 100, 28, GL_MOSS);
 
+            // Time left under the progress bar
+            char eta_str[CHAR_LIM];
+            duration_to_string(eta_str, CHAR_LIM, eta_ms / 1000);
+            gl_draw_string(309 / 2 - (strlen("ETA:_") + strlen(eta_str))*gl_get_char_width() / 2, 372 + gl_get_char_height() * 7 / 2, "ETA:", GL_AMBER);
+            gl_draw_string(309 / 2 - (strlen("ETA:_") + strlen(eta_str))*gl_get_char_width() / 2 + strlen("ETA:_")*gl_get_char_width(), 372 + gl_get_char_height() * 7 / 2, eta_str, GL_AMBER);
+
             // Cartridge levels on right side of screen - prints how many pieces of each color remain
             gl_draw_string(436 - strlen("INK CARTRIDGES")*gl_get_char_width() / 2, 10, "INK CARTRIDGES", GL_AMBER);
             for(int c = 0; c < MAX_COLORS; c++) {
                 gl_draw_rect(320 + (c % 3 * gl_get_char_width() * 6), 36 + (c / 3 * gl_get_char_height() * 5/2), 20, 20, GL_WHITE);
-                if(c < PRINTER_LIST[printer_index]->num_cartridges) {
+                if(c < job->color_map->num_cartridges) {
                     // Draw square of color on left side of number
-                    gl_draw_rect(322 + (c % 3 * gl_get_char_width() * 6), 38 + (c / 3 * gl_get_char_height() * 5/2), 16, 16, PRINTER_LIST[printer_index]->list_cartridges[c].color);
+                    gl_draw_rect(322 + (c % 3 * gl_get_char_width() * 6), 38 + (c / 3 * gl_get_char_height() * 5/2), 16, 16, job->color_map->list_cartridges[c].color);
                     
                     // Calculate number of LEGOs and convert to string
                     char count_str[CHAR_LIM];
                     count_str[0] = '\0';
-                    unsigned long lego_count = PRINTER_LIST[printer_index]->list_cartridges[c].capacity;
+                    unsigned long lego_count = inventory_count(&job->color_map->list_cartridges[c]);
                     num_to_string(count_str, CHAR_LIM, lego_count, 10, 0);
                     if(!lego_count) {
                         count_str[0] = '0';
@@ -386,11 +615,6 @@ void print_printer(void) {
                     
                     // Print string next to color
                     gl_draw_string(342 + (c % 3 * gl_get_char_width() * 6), 38 + (c / 3 * gl_get_char_height() * 5/2), count_str, GL_WHITE);
-
-                    // Remove printed pixel from capacity
-                    if(PRINTER_LIST[printer_index]->list_cartridges[c].color == down_scale->pixels[i]) {
-                        (PRINTER_LIST[printer_index]->list_cartridges[c].capacity)--;
-                    }
                 }
                 // If colors less than max of 30, print "N/A" with color square showing up as red "X"
                 else {
@@ -399,11 +623,46 @@ void print_printer(void) {
                     gl_draw_string(342 + (c % 3 * gl_get_char_width() * 6), 38 + (c / 3 * gl_get_char_height() * 5/2), "N/A", GL_WHITE);
                 }
             }
+            if(perf_overlay) print_overlay();
+            PERF_END(PERF_RENDER);
+
+            PERF_BEGIN(PERF_SWAP);
             gl_swap_buffer();
+            PERF_END(PERF_SWAP);
+            perf_record(PERF_BRICK, brick_start);
+            brick_start = hal_cycles();
 
         }
-        free(down_scale);
-        gl_swap_buffer();
+        // Send the rest of the job's trace before anything else is printed over UART
+        trace_flush();
+        isr_stats_print();
+
+        // A limit switch closing mid-print halts the machine and stops the program, and a fault before the first brick
+        // (homing that did not find its switches) means the print never started
+        bool refused = (i == PROGRAM_FAULT && !placed);
+        if(refused) print_refused("MOTION FAULT", "CHECK THE LIMIT SWITCHES");
+        else if(i == PROGRAM_FAULT) {
+            printf("Print stopped: limit switch hit\n");
+            checkpoint_print(&checkpoint);
+        }
+
+        // Bricks with no cartridge were left out of the program, so a run that reached its end is past them too
+        if(i == PROGRAM_END && checkpoint.next < last) checkpoint.next = last;
+
+        // Give back the bricks the run did not place, and offer to resume from the first of them
+        if(KEEP_TRACK_OF_LEGOS) inventory_release(&reservation);
+        resume_from = checkpoint.next;
+        resume_to = checkpoint.count;
+
+        // The print used up bricks, so rank the color maps again
+        ranked_bmp = -1;
+
+        // Let the last raise of the nozzle finish before leaving the printing page
+        wait_for_motion();
+        free(progress_us);
+        if(resume_program) program_free(resume_program);
+        if(!resume) placement_free(job);
+        if(!refused) gl_swap_buffer();
     }
 
 }
@@ -416,6 +675,32 @@ void print_printer(void) {
 int printer_read_input(void) {
     unsigned char input = module.printer_read();
 
+    // Hidden key: dump the profiler's samples over UART and start counting afresh
+    if(SAMPLE_PROFILER && input == PROFILE_KEY) {
+        profile_dump();
+        profile_reset();
+        return 1; // Continue
+    }
+
+    // Hidden key: print the heap use of the UI over UART
+    if(DEBUG_DUMPS && input == HEAP_KEY) {
+        heap_report();
+        return 1; // Continue
+    }
+
+    // Hidden key: dump the keys pressed so far over UART (to replay the session)
+    if(DEBUG_DUMPS && input == INPUT_KEY) {
+        input_dump();
+        return 1; // Continue
+    }
+
+    // Hidden key: show or hide the timings overlay (starting its timings afresh)
+    if(input == PERF_KEY) {
+        perf_overlay = !perf_overlay;
+        if(perf_overlay) perf_reset();
+        return 1; // Continue
+    }
+
     // If title screen, wait for enter to be pressed
     if(mode == MODE_TITLE) {
         if(input == ENTER) mode = MODE_SELECT;   
@@ -437,6 +722,8 @@ int printer_read_input(void) {
     if(mode == MODE_SELECT) {
         if((input == UP_ARROW && bmp_index > 0) || (input == DOWN_ARROW && bmp_index < BITMAP_LIST_SIZE - 1)) {
             printer_index = 0;
+            printer_chosen = false;
+            dither_index = DITHER_NONE;
             scale_index = 0;
             preview_menu_index = 0;
         }
@@ -450,10 +737,11 @@ int printer_read_input(void) {
     if(mode == MODE_PREVIEW) {
         // Change modes up and down depending on up arrow / down arrow
         if(input == UP_ARROW && preview_menu_index > 0) preview_menu_index--;
-        else if(input == DOWN_ARROW && preview_menu_index < 2) preview_menu_index++;
+        else if(input == DOWN_ARROW && preview_menu_index < (resumable ? RESUME_TO : PRINT_MODE)) preview_menu_index++;
         
         // Cycle through options on color mode
         else if(preview_menu_index == COLOR_MODE) {
+            if(input == LEFT_ARROW || input == RIGHT_ARROW) printer_chosen = true;
             if(input == LEFT_ARROW) {
                 if(printer_index == 0) printer_index = NUM_PRINTERS - 1;
                 else printer_index--;
@@ -464,6 +752,18 @@ int printer_read_input(void) {
             }
         }
 
+        // Cycle through options on dithering mode
+        else if(preview_menu_index == DITHER_MODE) {
+            if(input == LEFT_ARROW) {
+                if(dither_index == 0) dither_index = NUM_DITHER_MODES - 1;
+                else dither_index--;
+            }
+            else if(input == RIGHT_ARROW) {
+                if(dither_index == NUM_DITHER_MODES - 1) dither_index = 0;
+                else dither_index++;
+            }
+        }
+
         // Cycle through options on scale mode
         else if(preview_menu_index == SCALE_MODE) {
             if(input == LEFT_ARROW) {
@@ -475,6 +775,16 @@ int printer_read_input(void) {
                 else scale_index++;
             }
         }
+
+        // Move either end of the resume range, keeping at least one brick in it
+        else if(preview_menu_index == RESUME_FROM) {
+            if(input == LEFT_ARROW && resume_from > 0) resume_from--;
+            else if(input == RIGHT_ARROW && resume_from + 1 < resume_to) resume_from++;
+        }
+        else if(preview_menu_index == RESUME_TO) {
+            if(input == LEFT_ARROW && resume_to > resume_from + 1) resume_to--;
+            else if(input == RIGHT_ARROW && resume_to < checkpoint.count) resume_to++;
+        }
     }
 
     // After printing is done, switch to preview mode on any input
@@ -487,6 +797,10 @@ int printer_read_input(void) {
     if(input == ESC) mode--;
     if(input == ENTER && mode <= MODE_PRINTING) {
         if(mode == MODE_PREVIEW && preview_menu_index == PRINT_MODE && scale_index != PREV) mode++;
+        if(mode == MODE_PREVIEW && preview_menu_index >= RESUME_FROM && resumable && resume_from < resume_to) {
+            resuming = true;
+            mode++;
+        }
         if(mode <= MODE_SELECT) mode++;
 	}
     return 1;
@@ -501,6 +815,8 @@ void printer_run(void) {
     int state = 1;
 
     while(state) {
+        PERF_BEGIN(PERF_FRAME);
+
         // Clear to black
         gl_clear(GL_BLACK);
 
@@ -511,9 +827,12 @@ void printer_run(void) {
         print_preview();
         print_quit();
         print_printer();
+        if(perf_overlay) print_overlay();
 
         // Swap buffer and wait for next input
         gl_swap_buffer();
+        PERF_END(PERF_FRAME);
+        heap_frame();
         state = printer_read_input();
     }
 }
\ No newline at end of file
@@ -46,36 +46,78 @@ int num_to_string(char *buf, size_t bufsize, unsigned long val, int base, size_t
     return offset; 
 }
 
+/* Function: duration_to_string()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ * Converts a duration in seconds to a short string such as "1H 05M"
+ * (or "4M 09S" under an hour).
+ */
+int duration_to_string(char *buf, size_t bufsize, unsigned long seconds) {
+    char minor_str[3];
+    unsigned long major = seconds / 3600, minor = seconds / 60 % 60;
+    const char *major_unit = "H ", *minor_unit = "M";
+    if(!major) {
+        major = seconds / 60;
+        minor = seconds % 60;
+        major_unit = "M ";
+        minor_unit = "S";
+    }
+    num_to_string(buf, bufsize, major, DEC, 1);
+    strlcat(buf, major_unit, bufsize);
+    minor_str[0] = ZERO_CHAR + minor / 10;
+    minor_str[1] = ZERO_CHAR + minor % 10;
+    minor_str[2] = '\0';
+    strlcat(buf, minor_str, bufsize);
+    return strlcat(buf, minor_unit, bufsize);
+}
+
 // List of different scale modes
 struct scale_mode PREV = {
     .name = (char*)"PREV",
     .width = 80,
     .height = 80,
+    .scale = 80,
+    .x_start = 0,
+    .y_start = 0,
 };
 struct scale_mode TWNTY = {
     .name = (char*)"20x20",
     .width = 20,
     .height = 20,
+    .scale = 20,
+    .x_start = 0,
+    .y_start = 0,
 };
 struct scale_mode FRTY_TL = {
     .name = (char*)"40xTL",
     .width = 20,
     .height = 20,
+    .scale = 40,
+    .x_start = 0,
+    .y_start = 0,
 };
 struct scale_mode FRTY_TR = {
     .name = (char*)"40xTR",
     .width = 20,
     .height = 20,
+    .scale = 40,
+    .x_start = 20,
+    .y_start = 0,
 };
 struct scale_mode FRTY_BR = {
     .name = (char*)"40xBR",
     .width = 20,
     .height = 20,
+    .scale = 40,
+    .x_start = 20,
+    .y_start = 20,
 };
 struct scale_mode FRTY_BL = {
     .name = (char*)"40xBL",
     .width = 20,
     .height = 20,
+    .scale = 40,
+    .x_start = 0,
+    .y_start = 20,
 };
 
 // Array of all scale modes + number of scale modes
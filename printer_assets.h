@@ -29,9 +29,23 @@
  */
 int num_to_string(char *buf, size_t bufsize, unsigned long val, int base, size_t min_width);
 
+/*
+ * `duration_to_string`
+ *
+ * Converts a duration to a string of hours and minutes ("1H 05M"), or minutes and seconds under an hour ("4M 09S").
+ *
+ * @param buf          the char* buffer where the final string is stored
+ * @param bufsize      the size of `buf`
+ * @param seconds      the duration in seconds
+ */
+int duration_to_string(char *buf, size_t bufsize, unsigned long seconds);
+
+// Contains a `name`, the `width` x `height` of the part printed, and the `scale` x `scale` downscale of the image
+// that part is cut from, at {`x_start`, `y_start`}
 struct scale_mode {
     char* name;
     unsigned int width, height;
+    unsigned int scale, x_start, y_start;
 };
 
 extern struct scale_mode PREV;
@@ -5,25 +5,16 @@
  */ 
 
 // Library Imports
-#include "gl.h"
-#include "gpio.h"
-#include "gpio_extra.h"
-#include "gpio_interrupt.h"
-#include "interrupts.h"
 #include "printf.h"
-#include "ringbuffer.h"
-#include "uart.h"
-#include "malloc.h"
-#include "hstimer.h"
 
 // Project Imports
+#include "hal.h"
+#include "isr_stats.h"
+#include "kinematics.h"
+#include "motion_program.h"
 #include "printer_driver.h"
-
-static const gpio_id_t X_STEP_PIN = GPIO_PB4, Y_STEP_PIN = GPIO_PB3, Z_STEP_PIN = GPIO_PB2;
-static const gpio_id_t X_DIR_PIN = GPIO_PD17, Y_DIR_PIN = GPIO_PB6, Z_DIR_PIN = GPIO_PB12;
-static const gpio_id_t X_LIMIT_PIN = GPIO_PC0, Y_LIMIT_PIN = GPIO_PC1, Z_LIMIT_PIN = GPIO_PB11;
-
-static const gpio_id_t VACUUM_PIN = GPIO_PB10;
+#include "profile.h"
+#include "trace.h"
 
 static volatile  int X_STEP_PIN_State, X_Steps, X_Current_Steps, X_Target_Interval, X_Current_Interval, X_Intermediary_Interval;
 
@@ -33,36 +24,39 @@ static volatile  int Z_STEP_PIN_State, Z_Steps, Z_Current_Steps, Z_Target_Interv
 
 static volatile int X_Position, Y_Position, Z_Position;
 
-static volatile unsigned int X_Zero_Reference = 45000, Y_Zero_Reference = 3000;
+static volatile int X_Direction, Y_Direction, Z_Direction;
 
-unsigned int find_max (unsigned int x, unsigned int y, unsigned int z) {
+static volatile int X_Limit_Hit, Y_Limit_Hit, Z_Limit_Hit;
 
-    if (x == 0 && y == 0 && z == 0){
-        return 0;
-    }
-    else if (x >= y && x > z){
-        return 1;
-    }
-    else if (y > x && y >= z){
-        return 2;
-    }
-    else {
-        return 3;
-    }
-}
+static volatile bool Homing, Motion_Fault;
+
+static bool Vacuum_On, Fault_Traced;
+
+// Homing: fast approach (giving up after HOME_TRAVEL steps), back off HOME_BACKOFF steps, then a slow re-approach
+#define HOME_TRAVEL 200000
+#define HOME_BACKOFF 400
+#define HOME_SLOW_INTERVAL 60
+
+// Vacuum timings used by pick_and_place (heights and speeds come from the kinematics table)
+struct cycle_config cycle_config = {
+    .vacuum_on_lead_us = 30000,
+    .vacuum_off_lead_us = 0,
+};
 
 static void steppers(uintptr_t pc, void *aux_data) {
-    hstimer_interrupt_clear(HSTIMER0);
+    unsigned long entry = hal_cycles();
+    hal_timer_clear();
+    profile_sample(pc);
 
     //movement for X stepper motor
     if (X_Steps > 0){
         X_Current_Interval ++;
         if (X_Current_Interval == X_Intermediary_Interval){
             if (X_STEP_PIN_State == 1){
-                gpio_write(X_STEP_PIN, 0);
+                hal_step_write(AXIS_X, 0);
                 X_STEP_PIN_State = 0;
                 X_Steps --;
-                if (X_Intermediary_Interval > X_Target_Interval && X_Steps > 100){
+                if (X_Intermediary_Interval > X_Target_Interval && X_Steps > machine.axes[AXIS_X].decel_steps){
                     X_Intermediary_Interval --;
                 }
                 else {
@@ -70,7 +64,7 @@ static void steppers(uintptr_t pc, void *aux_data) {
                 }
             }
             else {
-                gpio_write(X_STEP_PIN, 1);
+                hal_step_write(AXIS_X, 1);
                 X_STEP_PIN_State = 1;
             }
             X_Current_Interval = 0;
@@ -82,10 +76,10 @@ static void steppers(uintptr_t pc, void *aux_data) {
         Y_Current_Interval ++;
         if (Y_Current_Interval == Y_Intermediary_Interval){
             if (Y_STEP_PIN_State == 1){
-                gpio_write(Y_STEP_PIN, 0);
+                hal_step_write(AXIS_Y, 0);
                 Y_STEP_PIN_State = 0;
                 Y_Steps --;
-                if (Y_Intermediary_Interval > Y_Target_Interval && Y_Steps > 100){
+                if (Y_Intermediary_Interval > Y_Target_Interval && Y_Steps > machine.axes[AXIS_Y].decel_steps){
                     Y_Intermediary_Interval --;
                 }
                 else {
@@ -93,7 +87,7 @@ static void steppers(uintptr_t pc, void *aux_data) {
                 }
             }
             else {
-                gpio_write(Y_STEP_PIN, 1);
+                hal_step_write(AXIS_Y, 1);
                 Y_STEP_PIN_State = 1;
             }
             Y_Current_Interval = 0;
@@ -105,10 +99,10 @@ static void steppers(uintptr_t pc, void *aux_data) {
         Z_Current_Interval ++;
         if (Z_Current_Interval == Z_Intermediary_Interval){
             if (Z_STEP_PIN_State == 1){
-                gpio_write(Z_STEP_PIN, 0);
+                hal_step_write(AXIS_Z, 0);
                 Z_STEP_PIN_State = 0;
                 Z_Steps --;
-                if (Z_Intermediary_Interval > Z_Target_Interval && Z_Steps > 100){
+                if (Z_Intermediary_Interval > Z_Target_Interval && Z_Steps > machine.axes[AXIS_Z].decel_steps){
                     Z_Intermediary_Interval --;
                 }
                 else {
@@ -116,151 +110,390 @@ static void steppers(uintptr_t pc, void *aux_data) {
                 }
             }
             else {
-                gpio_write(Z_STEP_PIN, 1);
+                hal_step_write(AXIS_Z, 1);
                 Z_STEP_PIN_State = 1;
             }
             Z_Current_Interval = 0;
         }
     }
-    
+
+    isr_stats_record(entry, hal_cycles());
 }
 
 void configure_steppers(void) {
-    // armtimer is intialized to number of usecs between events
-    gpio_set_output(X_STEP_PIN);
-    gpio_set_output(Y_STEP_PIN);
-    gpio_set_output(Z_STEP_PIN);
-    gpio_set_output(X_DIR_PIN);
-    gpio_set_output(Y_DIR_PIN);
-    gpio_set_output(Z_DIR_PIN);
-    hstimer_init(HSTIMER0, 10);
-    hstimer_enable(HSTIMER0);             // enable timer itself
-    interrupts_register_handler(INTERRUPT_SOURCE_HSTIMER0, steppers, NULL);
-    interrupts_enable_source(INTERRUPT_SOURCE_HSTIMER0);
+    hal_steppers_init();
+    hal_timer_init(STEPPER_TICK_US, steppers);
+}
+
+// Drops any step pin left high by a stopped axis (and restarts its interval count), otherwise the next move
+// would start on a falling edge and lose its first step
+static void end_pulses(void){
+    if (X_Steps == 0){
+        hal_step_write(AXIS_X, 0);
+        X_STEP_PIN_State = 0;
+        X_Current_Interval = 0;
+    }
+    if (Y_Steps == 0){
+        hal_step_write(AXIS_Y, 0);
+        Y_STEP_PIN_State = 0;
+        Y_Current_Interval = 0;
+    }
+    if (Z_Steps == 0){
+        hal_step_write(AXIS_Z, 0);
+        Z_STEP_PIN_State = 0;
+        Z_Current_Interval = 0;
+    }
+}
+
+// Called whenever a limit switch closes. Outside of homing, hitting a switch means something went wrong,
+// so every axis is stopped where it is and no new moves start until the machine is homed again
+static void limit_hit(void){
+    if (Homing) return;
+    X_Position = X_Position - X_Direction * X_Steps;
+    Y_Position = Y_Position - Y_Direction * Y_Steps;
+    Z_Position = Z_Position - Z_Direction * Z_Steps;
+    X_Steps = 0;
+    Y_Steps = 0;
+    Z_Steps = 0;
+    end_pulses();
+    Motion_Fault = true;
+}
+
+// The limit handlers latch where the axis was when its switch closed and stop that axis right away
+static void x_limit(uintptr_t pc, void *aux_data){
+    hal_limit_clear(AXIS_X);
+    X_Position = X_Position - X_Direction * X_Steps;
+    X_Steps = 0;
+    X_Limit_Hit = 1;
+    end_pulses();
+    limit_hit();
+}
+
+static void y_limit(uintptr_t pc, void *aux_data){
+    hal_limit_clear(AXIS_Y);
+    Y_Position = Y_Position - Y_Direction * Y_Steps;
+    Y_Steps = 0;
+    Y_Limit_Hit = 1;
+    end_pulses();
+    limit_hit();
+}
+
+static void z_limit(uintptr_t pc, void *aux_data){
+    hal_limit_clear(AXIS_Z);
+    Z_Position = Z_Position - Z_Direction * Z_Steps;
+    Z_Steps = 0;
+    Z_Limit_Hit = 1;
+    end_pulses();
+    limit_hit();
 }
 
 void configure_limit_switches(void){
-    gpio_set_input (X_LIMIT_PIN);
-    gpio_set_pullup(X_LIMIT_PIN);
-    gpio_set_input (Y_LIMIT_PIN);
-    gpio_set_pullup(Y_LIMIT_PIN);
-    gpio_set_input (Z_LIMIT_PIN);
-    gpio_set_pullup(Z_LIMIT_PIN);
+    static const hal_handler_t handlers[NUM_AXES] = { x_limit, y_limit, z_limit };
+    hal_limits_init(handlers);
+}
+
+bool motion_faulted(void){
+    return Motion_Fault;
 }
 
 void configure_vacuum (void) {
-    gpio_set_output(VACUUM_PIN);
+    hal_vacuum_init();
 }
 
 void activate_vacuum (void) {
-    gpio_write(VACUUM_PIN, 1);
+    hal_vacuum_write(1);
+    Vacuum_On = true;
+    trace_event(TRACE_VACUUM, X_Position, Y_Position, Z_Position, Vacuum_On);
 }
 
 void deactivate_vacuum (void) {
-    gpio_write(VACUUM_PIN, 0);
+    hal_vacuum_write(0);
+    Vacuum_On = false;
+    trace_event(TRACE_VACUUM, X_Position, Y_Position, Z_Position, Vacuum_On);
+}
+
+// Every wait on the steppers idles here, which also drains the trace and records a fault once the limit handler
+// has stopped the machine (the trace is only ever written from the main loop)
+static void idle(void){
+    hal_idle();
+    if (Motion_Fault && !Fault_Traced){
+        Fault_Traced = true;
+        trace_event(TRACE_FAULT, X_Position, Y_Position, Z_Position, Vacuum_On);
+    }
+    trace_poll();
 }
 
-void move_steppers (int x, int y, int z, int velocity){
-    // If the desired x move, is less than 0, we need to flip the Dir pin output, and get the absolute of the steps
+void move_to(int X_Desired_Position, int Y_Desired_Position, int Z_Desired_Position, int speed){
+    //start every axis that has to move, then wait for all of them to stop
+    move_to_async(X_Desired_Position, Y_Desired_Position, Z_Desired_Position, speed);
+    wait_for_motion();
+}
+
+// The start_* helpers program a single axis without touching the other two, waiting for the axis to be idle first
+// (and starting nothing if a limit switch closed meanwhile). The position is moved to the target before the step
+// count is written last, so the interrupt never sees a half configured move. A limit switch closing after the first
+// check disarms the axis again once the steps are written, taking the steps left off the position the way
+// `limit_hit` does (and if it closed after the write, `limit_hit` already has)
+static void start_x(int x, int velocity){
+    while (X_Steps != 0) { idle(); }
+    if (Motion_Fault && !Homing) return;
     if (x < 0){
-        gpio_write(X_DIR_PIN, 0);
-        X_Steps = -x;
+        hal_dir_write(AXIS_X, 0);
+        X_Direction = -1;
     }
     else {
-        gpio_write(X_DIR_PIN, 1);
-        X_Steps = x;
+        hal_dir_write(AXIS_X, 1);
+        X_Direction = 1;
     }
+    X_Intermediary_Interval = machine.axes[AXIS_X].start_interval;
+    X_Target_Interval = axis_interval(AXIS_X, velocity);
+    X_Position = X_Position + x;
+    X_Steps = (x < 0) ? -x : x;
+    if (Motion_Fault && !Homing){
+        X_Position = X_Position - X_Direction * X_Steps;
+        X_Steps = 0;
+    }
+}
 
+static void start_y(int y, int velocity){
+    while (Y_Steps != 0) { idle(); }
+    if (Motion_Fault && !Homing) return;
     if (y < 0){
-        gpio_write(Y_DIR_PIN, 0);
-        Y_Steps = -y;
+        hal_dir_write(AXIS_Y, 0);
+        Y_Direction = -1;
     }
     else {
-        gpio_write(Y_DIR_PIN, 1);
-        Y_Steps = y;
+        hal_dir_write(AXIS_Y, 1);
+        Y_Direction = 1;
     }
+    Y_Intermediary_Interval = machine.axes[AXIS_Y].start_interval;
+    Y_Target_Interval = axis_interval(AXIS_Y, velocity);
+    Y_Position = Y_Position + y;
+    Y_Steps = (y < 0) ? -y : y;
+    if (Motion_Fault && !Homing){
+        Y_Position = Y_Position - Y_Direction * Y_Steps;
+        Y_Steps = 0;
+    }
+}
 
+static void start_z(int z, int velocity){
+    while (Z_Steps != 0) { idle(); }
+    if (Motion_Fault && !Homing) return;
     if (z < 0){
-        gpio_write(Z_DIR_PIN, 0);
-        Z_Steps = -z;
+        hal_dir_write(AXIS_Z, 0);
+        Z_Direction = -1;
     }
     else {
-        gpio_write(Z_DIR_PIN, 1);
-        Z_Steps = z;
+        hal_dir_write(AXIS_Z, 1);
+        Z_Direction = 1;
     }
+    Z_Intermediary_Interval = machine.axes[AXIS_Z].start_interval;
+    Z_Target_Interval = axis_interval(AXIS_Z, velocity);
+    Z_Position = Z_Position + z;
+    Z_Steps = (z < 0) ? -z : z;
+    if (Motion_Fault && !Homing){
+        Z_Position = Z_Position - Z_Direction * Z_Steps;
+        Z_Steps = 0;
+    }
+}
 
-    unsigned int largestMove = find_max(X_Steps, Y_Steps, Z_Steps);
-    X_Intermediary_Interval = 150; // STARTING SPEED FOR THE STEPPERS
-    Y_Intermediary_Interval = 150; // LOWER SPEED = MORE TORQUE
-    Z_Intermediary_Interval = 150;
+void move_to_async(int X_Desired_Position, int Y_Desired_Position, int Z_Desired_Position, int speed){
+    //a target past the soft limits is refused, faulting the machine like a limit switch would (moves under way finish)
+    bool within = within_limits(AXIS_X, X_Desired_Position);
+    within = within_limits(AXIS_Y, Y_Desired_Position) && within;
+    within = within_limits(AXIS_Z, Z_Desired_Position) && within;
+    if (!within) Motion_Fault = true;
 
-    X_Target_Interval = velocity;
-    Y_Target_Interval = velocity;
-    Z_Target_Interval = velocity;
-}
+    //calculate how much each motor needs to move
+    int X_move = X_Desired_Position - X_Position;
+    int Y_move = Y_Desired_Position - Y_Position;
+    int Z_move = Z_Desired_Position - Z_Position;
 
-void home_steppers(void){
-    while (gpio_read(Z_LIMIT_PIN) == 1){
-        gpio_write(Z_LIMIT_PIN, 0);
-        Z_Steps = 101;
-        Z_Target_Interval = 10;
-        Z_Intermediary_Interval = 20;
+    //axes that are already at (or heading to) their target are left alone, so a blended move never stops them
+    if (Motion_Fault) return;
+    trace_move(X_Desired_Position, Y_Desired_Position, Z_Desired_Position, X_move, Y_move, Z_move, speed, Vacuum_On);
+    if (X_move != 0){
+        start_x(X_move, speed);
     }
-    
-    while (Z_Steps != 0) {}
-
-    while (gpio_read(Y_LIMIT_PIN) == 1){
-        gpio_write(Y_DIR_PIN, 0);
-        Y_Steps = 101;
-        Y_Target_Interval = 10;
-        Y_Intermediary_Interval = 20;
+    if (Y_move != 0){
+        start_y(Y_move, speed);
     }
+    if (Z_move != 0){
+        start_z(Z_move, speed);
+    }
+}
 
-    while (Y_Steps != 0) {}
+void wait_for_motion(void){
+    while (X_Steps != 0 || Y_Steps != 0 || Z_Steps != 0) { idle(); }
+}
+
+// Runs the selected axes towards their limit switches until they close (axes already on their switch stay put)
+static void seek_limits(bool x, bool y, bool z, int velocity){
+    X_Limit_Hit = hal_limit_read(AXIS_X);
+    Y_Limit_Hit = hal_limit_read(AXIS_Y);
+    Z_Limit_Hit = hal_limit_read(AXIS_Z);
+    if (x && !X_Limit_Hit) start_x(-HOME_TRAVEL, velocity);
+    if (y && !Y_Limit_Hit) start_y(-HOME_TRAVEL, velocity);
+    if (z && !Z_Limit_Hit) start_z(-HOME_TRAVEL, velocity);
+}
 
-    while (gpio_read(X_LIMIT_PIN) == 1){
-        gpio_write(X_DIR_PIN, 0);
-        X_Steps = 101;
-        X_Target_Interval = 10;
-        X_Intermediary_Interval = 20;
+static void back_off(bool x, bool y, bool z){
+    if (x) start_x(HOME_BACKOFF, HOME_SLOW_INTERVAL);
+    if (y) start_y(HOME_BACKOFF, HOME_SLOW_INTERVAL);
+    if (z) start_z(HOME_BACKOFF, HOME_SLOW_INTERVAL);
+}
+
+bool home_steppers(void){
+    wait_for_motion();
+    Homing = true;
+
+    //Z goes up first, X and Y only start once the nozzle is clear and finish their phases alongside Z
+    seek_limits(false, false, true, SPEED_MAX);
+    wait_for_motion();
+    back_off(false, false, true);
+    seek_limits(true, true, false, SPEED_MAX);
+    wait_for_motion();
+    seek_limits(false, false, true, HOME_SLOW_INTERVAL);
+    back_off(true, true, false);
+    wait_for_motion();
+    seek_limits(true, true, false, HOME_SLOW_INTERVAL);
+    wait_for_motion();
+
+    //without all three switches there is no zero, so the machine stays faulted (and where it thinks it is)
+    Homing = false;
+    trace_event(TRACE_HOME, X_Limit_Hit, Y_Limit_Hit, Z_Limit_Hit, Vacuum_On);
+    if (!X_Limit_Hit || !Y_Limit_Hit || !Z_Limit_Hit){
+        printf("Homing: limit switch not found (X: %d, Y: %d, Z: %d)\n", X_Limit_Hit, Y_Limit_Hit, Z_Limit_Hit);
+        Motion_Fault = true;
+        return false;
     }
-    while (X_Steps != 0) {}
-    
+
+    //the switches are the new zero
+    X_Position = 0;
+    Y_Position = 0;
+    Z_Position = 0;
+    Motion_Fault = false;
+    Fault_Traced = false;
+    return true;
 }
 
-void move_to(int X_Desired_Position, int Y_Desired_Position, int Z_Desired_Position, int speed){
-    //calculate how much each motor needs to move
-    int X_move = X_Desired_Position - X_Position;
-    int Y_move = Y_Desired_Position - Y_Position;
-    int Z_move = Z_Desired_Position - Z_Position;
+static unsigned long longest(unsigned long a, unsigned long b, unsigned long c){
+    if (b > a) a = b;
+    return (c > a) ? c : a;
+}
 
-    // update the current position for each of the axis
-    X_Position = X_Desired_Position;
-    Y_Position = Y_Desired_Position;
-    Z_Position = Z_Desired_Position;
+unsigned long home_estimate(int x, int y, int z){
+    // Same phases as home_steppers, each lasting as long as its slowest axis
+    const struct axis_config *X = &machine.axes[AXIS_X], *Y = &machine.axes[AXIS_Y], *Z = &machine.axes[AXIS_Z];
+    unsigned long seek_x = ramp_ticks(HOME_TRAVEL, X->start_interval, axis_interval(AXIS_X, SPEED_MAX), X->decel_steps, x);
+    unsigned long seek_y = ramp_ticks(HOME_TRAVEL, Y->start_interval, axis_interval(AXIS_Y, SPEED_MAX), Y->decel_steps, y);
+    unsigned long seek_z = ramp_ticks(HOME_TRAVEL, Z->start_interval, axis_interval(AXIS_Z, SPEED_MAX), Z->decel_steps, z);
+    unsigned long back_x = ramp_ticks(HOME_BACKOFF, X->start_interval, HOME_SLOW_INTERVAL, X->decel_steps, HOME_BACKOFF);
+    unsigned long back_y = ramp_ticks(HOME_BACKOFF, Y->start_interval, HOME_SLOW_INTERVAL, Y->decel_steps, HOME_BACKOFF);
+    unsigned long back_z = ramp_ticks(HOME_BACKOFF, Z->start_interval, HOME_SLOW_INTERVAL, Z->decel_steps, HOME_BACKOFF);
+    unsigned long slow_x = ramp_ticks(HOME_TRAVEL, X->start_interval, HOME_SLOW_INTERVAL, X->decel_steps, HOME_BACKOFF);
+    unsigned long slow_y = ramp_ticks(HOME_TRAVEL, Y->start_interval, HOME_SLOW_INTERVAL, Y->decel_steps, HOME_BACKOFF);
+    unsigned long slow_z = ramp_ticks(HOME_TRAVEL, Z->start_interval, HOME_SLOW_INTERVAL, Z->decel_steps, HOME_BACKOFF);
+
+    unsigned long ticks = seek_z;
+    ticks += longest(back_z, seek_x, seek_y);
+    ticks += longest(slow_z, back_x, back_y);
+    ticks += longest(0, slow_x, slow_y);
+    return ticks * STEPPER_TICK_US;
+}
+
+unsigned long ramp_ticks(int steps, int interval, int target, int decel_steps, int count){
+    // Mirrors the ramp in `steppers`: every step takes two toggles of `interval` ticks, after each step the interval
+    // drops by one while above the target and more than `decel_steps` steps remain, otherwise it grows by one
+    // (which makes a cruising axis alternate between target and target + 1)
+    unsigned long ticks = 0;
+    int done = 0;
+    if (count > steps) count = steps;
+
+    //acceleration
+    int accel = steps - decel_steps - 1;
+    if (interval - target < accel) accel = interval - target;
+    if (accel < 0) accel = 0;
+    if (accel > count) accel = count;
+    ticks += (unsigned long)accel * interval - (unsigned long)accel * (accel - 1) / 2;
+    interval -= accel;
+    done += accel;
+
+    //cruise (only reached once the interval is at or below the target)
+    int cruise = steps - decel_steps - 1 - done;
+    if (cruise < 0) cruise = 0;
+    if (cruise > count - done) cruise = count - done;
+    if (cruise > 0){
+        //an interval below the target first grows back up to target + 1
+        int rise = target + 1 - interval;
+        if (rise < 0) rise = 0;
+        if (rise > cruise) rise = cruise;
+        ticks += (unsigned long)rise * interval + (unsigned long)rise * (rise - 1) / 2;
+        interval += rise;
+        int alternating = cruise - rise;
+        ticks += (unsigned long)alternating * target;
+        if (interval == target + 1) ticks += (alternating + 1) / 2;
+        else ticks += alternating / 2;
+        if (alternating % 2) interval = (interval == target) ? target + 1 : target;
+        done += cruise;
+    }
+
+    //deceleration
+    int decel = count - done;
+    ticks += (unsigned long)decel * interval + (unsigned long)decel * (decel - 1) / 2;
+
+    return 2 * ticks;
+}
 
-    //move the stepper to the desired position
-    printf("X_move: %d,  Y_move: %d, Z_move: %d,   %d\n", X_move, Y_move, Z_move, ((X_move * X_move) + (Y_move * Y_move) + (Z_move * Z_move)));
-    move_steppers(X_move, Y_move, Z_move, speed);
+// Position of the Z axis right now (Z_Position already holds the target of the current move)
+static int live_z(void){
+    return Z_Position - Z_Direction * Z_Steps;
+}
 
-    while (X_Steps != 0 || Y_Steps != 0 || Z_Steps != 0) {}
+// Microseconds until the given axis finishes its current move
+static unsigned long z_remaining_us(void){
+    return ramp_ticks(Z_Steps, Z_Intermediary_Interval, Z_Target_Interval, machine.axes[AXIS_Z].decel_steps, Z_Steps) * STEPPER_TICK_US;
+}
+
+static unsigned long xy_remaining_us(void){
+    unsigned long x = ramp_ticks(X_Steps, X_Intermediary_Interval, X_Target_Interval, machine.axes[AXIS_X].decel_steps, X_Steps);
+    unsigned long y = ramp_ticks(Y_Steps, Y_Intermediary_Interval, Y_Target_Interval, machine.axes[AXIS_Y].decel_steps, Y_Steps);
+    return ((x > y) ? x : y) * STEPPER_TICK_US;
+}
 
+void wait_for_clearance(void){
+    while (live_z() > machine.clear_z && !Motion_Fault) { idle(); }
+}
+
+void wait_for_xy(unsigned long us){
+    while (xy_remaining_us() > us) { idle(); }
+}
+
+void wait_for_z(unsigned long us){
+    while (z_remaining_us() > us) { idle(); }
+}
+
+int axis_position(int axis){
+    if (axis == AXIS_X) return X_Position;
+    if (axis == AXIS_Y) return Y_Position;
+    return Z_Position;
+}
+
+coordinate brick_position(int X_End_Position, int Y_End_Position){
+    coordinate brick;
+    brick.x = X_End_Position * brick_pitch(AXIS_X) + machine.plate_x;
+    brick.y = Y_End_Position * brick_pitch(AXIS_Y) + machine.plate_y;
+    return brick;
 }
 
 void pick_and_place(int X_End_Position, int Y_End_Position, coordinate color){
-    int Brick_X_Coordinate = color.x;
-    int Brick_Y_Coordinate = color.y; 
-
-    unsigned int X_Coordinate_End_Position = X_End_Position * 3200 + X_Zero_Reference;
-    unsigned int Y_Coordinate_End_Position = Y_End_Position * 3200 + Y_Zero_Reference;
-
-    move_to(Brick_X_Coordinate, Brick_Y_Coordinate, 3000, 7);                    // First go to the position where the brick of the specified color is located
-    move_to(Brick_X_Coordinate, Brick_Y_Coordinate, 8000, 10);                   // Then lower the pick and place nozzle 
-    activate_vacuum();                                                           // Turn the vacuum on
-    move_to(Brick_X_Coordinate, Brick_Y_Coordinate, 3000, 10);                   // Go back up
-    move_to(X_Coordinate_End_Position, Y_Coordinate_End_Position, 3000, 7);      // Go to the end position of the brick
-    move_to(X_Coordinate_End_Position, Y_Coordinate_End_Position, 9000, 10);     // Place the part
-    deactivate_vacuum();                                                         // Turn the vacuum off
-    move_to(X_Coordinate_End_Position, Y_Coordinate_End_Position, 3000, 10);     // Raise the pick and place arm
-    
-}
\ No newline at end of file
+    //compile a single cycle starting from where the machine is now, and run it
+    unsigned char code[CYCLE_CODE_SIZE + END_CODE_SIZE];
+    struct motion_program cycle;
+    program_init(&cycle, code, sizeof(code), X_Position, Y_Position, Z_Position);
+    program_emit_cycle(&cycle, color, brick_position(X_End_Position, Y_End_Position));
+    program_emit_end(&cycle);
+
+    unsigned int pc = 0;
+    program_run(&cycle, &pc);
+}
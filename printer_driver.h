@@ -1,6 +1,9 @@
 #ifndef PRINTER_DRIVER_H
 #define PRINTER_DRIVER_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 struct coordinate {
     int x;
     int y;
@@ -8,7 +11,15 @@ struct coordinate {
 
 typedef struct coordinate coordinate;
 
-unsigned int find_max (unsigned int x, unsigned int y, unsigned int z);
+// One tick of the stepper timer
+#define STEPPER_TICK_US 10
+
+// Pick-and-place cycle settings: how long before the nozzle stops the vacuum switches, in microseconds
+struct cycle_config {
+    unsigned int vacuum_on_lead_us, vacuum_off_lead_us;
+};
+
+extern struct cycle_config cycle_config;
 
 static void steppers(uintptr_t pc, void *aux_data);
 
@@ -16,18 +27,36 @@ void configure_steppers(void);
 
 void configure_limit_switches(void);
 
+bool motion_faulted(void);
+
 void configure_vacuum (void);
 
 void activate_vacuum (void);
 
 void deactivate_vacuum (void);
 
-void move_steppers (int x, int y, int z, int velocity);
+bool home_steppers(void);
 
-void home_steppers(void);
+unsigned long home_estimate(int x, int y, int z);
 
 void move_to(int X_Desired_Position, int Y_Desired_Position, int Z_Desired_Position, int speed);
 
+void move_to_async(int X_Desired_Position, int Y_Desired_Position, int Z_Desired_Position, int speed);
+
+void wait_for_motion(void);
+
+void wait_for_clearance(void);
+
+void wait_for_xy(unsigned long us);
+
+void wait_for_z(unsigned long us);
+
+int axis_position(int axis);
+
+unsigned long ramp_ticks(int steps, int interval, int target, int decel_steps, int count);
+
+coordinate brick_position(int X_End_Position, int Y_End_Position);
+
 void pick_and_place(int X_End_Position, int Y_End_Position, coordinate color);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+/* File: profile.c
+ * =-=-=-=-=-=-=-=
+ * Histogram of the PCs interrupted by the stepper timer.
+ */
+
+// Library Imports
+#include "printf.h"
+
+// Project Imports
+#include "profile.h"
+
+// Constants
+#define MAX_PROBES 8
+
+// Contains a sampled PC and how many samples landed on it
+struct slot {
+    uintptr_t pc;
+    unsigned int count;
+};
+
+static struct slot slots[PROFILE_SLOTS];
+static volatile unsigned int samples, unbinned, ticks;
+static volatile bool sampling;
+
+void profile_enable(bool on) {
+    sampling = on;
+}
+
+/* Function: profile_sample()
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-
+ * Runs in the stepper interrupt: does nothing unless sampling, and only
+ * looks up the PC on every PROFILE_EVERY-th tick. PCs that find no free
+ * slot within MAX_PROBES of their hash are only counted as unbinned.
+ */
+void profile_sample(uintptr_t pc) {
+    if(!sampling || ++ticks < PROFILE_EVERY) return;
+    ticks = 0;
+    samples++;
+
+    unsigned int hash = ((unsigned int)(pc >> 1) * 0x9e3779b1u) >> 22; // top 10 bits (PROFILE_SLOTS == 1 << 10)
+    for(int probe = 0; probe < MAX_PROBES; probe++) {
+        struct slot *slot = &slots[(hash + probe) & (PROFILE_SLOTS - 1)];
+        if(slot->count == 0) slot->pc = pc;
+        if(slot->pc == pc) {
+            slot->count++;
+            return;
+        }
+    }
+    unbinned++;
+}
+
+void profile_reset(void) {
+    bool was_sampling = sampling;
+    sampling = false;
+    for(int i = 0; i < PROFILE_SLOTS; i++) {
+        slots[i].pc = 0;
+        slots[i].count = 0;
+    }
+    samples = 0;
+    unbinned = 0;
+    ticks = 0;
+    sampling = was_sampling;
+}
+
+void profile_dump(void) {
+    // Sampling pauses so the table does not change halfway through
+    bool was_sampling = sampling;
+    sampling = false;
+    printf("PROFILE %d samples (every %d ticks), %d unbinned\n", samples, PROFILE_EVERY, unbinned);
+    for(int i = 0; i < PROFILE_SLOTS; i++) {
+        if(slots[i].count) printf("%lx %d\n", (unsigned long)slots[i].pc, slots[i].count);
+    }
+    printf("END PROFILE\n");
+    sampling = was_sampling;
+}
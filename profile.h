@@ -0,0 +1,53 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+ * Sampling profiler. While sampling, the stepper timer interrupt hands
+ * over the program counter it interrupted every PROFILE_EVERY ticks, and
+ * the number of samples at each distinct PC is kept in a fixed table (no
+ * allocation, a few instructions per sample). `profile_dump` prints the
+ * table over UART; `pyconversion/profile_symbolize.py` maps the PCs to
+ * functions of `davinci.elf`.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+#include <stdint.h>
+
+// Constants
+#define PROFILE_SLOTS 1024 // distinct PCs kept (a power of two)
+#define PROFILE_EVERY 10   // stepper ticks between samples (10 kHz with the 10us stepper tick)
+
+/*
+ * `profile_enable`
+ *
+ * Starts or stops sampling (samples already taken are kept).
+ *
+ * @param on          true to sample, false to stop
+ */
+void profile_enable(bool on);
+
+/*
+ * `profile_sample`
+ *
+ * Counts one tick of the sampling interrupt (call from the interrupt handler).
+ *
+ * @param pc          the program counter the interrupt stopped
+ */
+void profile_sample(uintptr_t pc);
+
+/*
+ * `profile_reset`
+ *
+ * Forgets every sample taken so far.
+ */
+void profile_reset(void);
+
+/*
+ * `profile_dump`
+ *
+ * Prints every sampled PC and its count over UART, between "PROFILE" and "END PROFILE" lines.
+ */
+void profile_dump(void);
+
+#endif
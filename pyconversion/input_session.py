@@ -0,0 +1,65 @@
+# File: input_session.py
+# =-=-=-=-=-=-=-=-=-=-=-
+# Turns the operator session dumped over UART by `input_dump`
+# (`input_log.c`) into `input_session.c`, to replay it on the printer.
+# Usage: python3 input_session.py [capture] > input_session.c (reads
+# stdin without a capture file).
+
+# Libraries
+import sys
+
+# Constants
+KEY_BITS = 8
+PER_LINE = 8
+HEADER = """/* File: input_session.c
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Operator session replayed at boot when REPLAY_SESSION is on in
+ * `davinci.c`. Regenerate from a UART capture holding an `input_dump`
+ * with `python3 pyconversion/input_session.py capture > input_session.c`.
+ */
+
+// Project Imports
+#include "input_log.h"
+"""
+
+# Function: read_events()
+# =-=-=-=-=-=-=-=-=-=-=-=
+# Returns the (ms, key) events of the last dump in a capture, skipping
+# anything else printed over UART.
+def read_events(lines):
+    events, inside = [], False
+    for line in lines:
+        line = line.strip()
+        if line.startswith("INPUT "):
+            events, inside = [], True
+        elif line == "END INPUT":
+            inside = False
+        elif inside:
+            ms, key = line.split()
+            events.append((int(ms), int(key, 16)))
+    return events
+
+# Function: write_session()
+# =-=-=-=-=-=-=-=-=-=-=-=-=
+# Prints `input_session.c` holding the events, packed as `input_log.h`
+# packs them.
+def write_session(events):
+    print(HEADER)
+    print(f'// {len(events)} keys over {sum(ms for ms, _ in events) / 1000:.1f} s')
+    print("const unsigned int INPUT_SESSION[] = {")
+    words = [f'0x{(ms << KEY_BITS) | key:08x}' for ms, key in events] or ["0"]
+    for i in range(0, len(words), PER_LINE):
+        print("    " + ", ".join(words[i:i + PER_LINE]) + ",")
+    print("};")
+    print(f'const unsigned int INPUT_SESSION_SIZE = {len(events)};')
+
+# Main Program
+if len(sys.argv) > 1:
+    with open(sys.argv[1], errors="replace") as capture:
+        events = read_events(capture)
+else:
+    events = read_events(sys.stdin)
+if not events:
+    print("No input session found in the capture.", file=sys.stderr)
+    sys.exit(1)
+write_session(events)
@@ -0,0 +1,77 @@
+# File: lab_tables.py
+# =-=-=-=-=-=-=-=-=-=
+# Generates `lab_tables.c`, the fixed-point lookup tables `img_process.c`
+# converts colors to CIE Lab with (sRGB gamma, the RGB to XYZ matrix, and
+# the cube root of Lab).
+# Usage (from the top of the repository, as the Makefile does):
+#     python3 pyconversion/lab_tables.py > lab_tables.c
+
+# Constants (must match `lab_tables.h`)
+LINEAR_ONE = 4095 # linear light of a full channel (and of the white point in XYZ)
+F_BITS = 10       # bits after the point of the cube root table
+XYZ_BITS = 12     # bits after the point of the RGB to XYZ matrix
+PER_LINE = 16
+DELTA = 6 / 29
+
+# Linear sRGB to XYZ (D65), with each row divided by the white point's X, Y or Z
+SRGB_TO_XYZ = [
+    [0.4124564, 0.3575761, 0.1804375],
+    [0.2126729, 0.7151522, 0.0721750],
+    [0.0193339, 0.1191920, 0.9503041],
+]
+HEADER = """/* File: lab_tables.c
+ * =-=-=-=-=-=-=-=-=-=
+ * Lookup tables for converting colors to CIE Lab in integer math.
+ * Generated by `pyconversion/lab_tables.py` - do not edit.
+ */
+
+// Project Imports
+#include "lab_tables.h"
+"""
+
+# Function: srgb_to_linear()
+# =-=-=-=-=-=-=-=-=-=-=-=-=-
+# Returns the linear light of an 8-bit sRGB channel, from 0 to 1.
+def srgb_to_linear(channel):
+    c = channel / 255
+    return c / 12.92 if c <= 0.04045 else ((c + 0.055) / 1.055) ** 2.4
+
+# Function: lab_f()
+# =-=-=-=-=-=-=-=-=
+# Returns the cube root of a normalized X, Y or Z value, with the linear
+# segment Lab uses near black.
+def lab_f(t):
+    return t ** (1 / 3) if t > DELTA ** 3 else t / (3 * DELTA ** 2) + 4 / 29
+
+# Function: xyz_row()
+# =-=-=-=-=-=-=-=-=-=
+# Returns a row of the RGB to XYZ matrix in fixed point, normalized to the
+# white point so white maps to exactly LINEAR_ONE (the rounding is taken
+# up by the largest coefficient).
+def xyz_row(row):
+    scaled = [round(c / sum(row) * (1 << XYZ_BITS)) for c in row]
+    scaled[scaled.index(max(scaled))] += (1 << XYZ_BITS) - sum(scaled)
+    return scaled
+
+# Function: print_table()
+# =-=-=-=-=-=-=-=-=-=-=-=
+# Prints a table as a C array.
+def print_table(declaration, values):
+    print(f'{declaration} = {{')
+    for i in range(0, len(values), PER_LINE):
+        print("    " + ", ".join(f'{v:4d}' for v in values[i:i + PER_LINE]) + ",")
+    print("};")
+
+# Main Program
+print(HEADER)
+print("// Linear light of each 8-bit sRGB channel value (out of LAB_LINEAR_ONE)")
+print_table("const unsigned short LAB_LINEAR[256]", [round(srgb_to_linear(c) * LINEAR_ONE) for c in range(256)])
+print()
+print("// Cube root of each normalized X, Y or Z value (out of LAB_LINEAR_ONE), with LAB_F_BITS bits after the point")
+print_table("const unsigned short LAB_F[LAB_LINEAR_ONE + 1]", [round(lab_f(t / LINEAR_ONE) * (1 << F_BITS)) for t in range(LINEAR_ONE + 1)])
+print()
+print("// Linear sRGB to X, Y and Z over the white point (D65), with LAB_XYZ_BITS bits after the point")
+print("const unsigned short LAB_XYZ[3][3] = {")
+for row in SRGB_TO_XYZ:
+    print("    { " + ", ".join(f'{c:4d}' for c in xyz_row(row)) + " },")
+print("};")
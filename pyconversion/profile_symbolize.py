@@ -0,0 +1,77 @@
+# File: profile_symbolize.py
+# =-=-=-=-=-=-=-=-=-=-=-=-=-
+# Maps the PCs dumped by the sampling profiler (`profile.c`) to the
+# functions of `davinci.elf`, and prints where the time went.
+# Usage: python3 profile_symbolize.py davinci.elf [capture]
+# (reads the UART capture from stdin without a capture file).
+
+# Libraries
+import bisect
+import subprocess
+import sys
+
+# Constants
+NM = "riscv64-unknown-elf-nm"
+TEXT_TYPES = "tTwW"
+TOP = 40
+
+# Function: load_symbols()
+# =-=-=-=-=-=-=-=-=-=-=-=-
+# Returns the addresses and names of the code symbols in `elf`, sorted
+# by address.
+def load_symbols(elf):
+    output = subprocess.run([NM, "-n", "--defined-only", elf], capture_output=True, text=True, check=True).stdout
+    addresses, names = [], []
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[1] in TEXT_TYPES:
+            addresses.append(int(fields[0], 16))
+            names.append(fields[2])
+    return addresses, names
+
+# Function: read_samples()
+# =-=-=-=-=-=-=-=-=-=-=-=-
+# Returns the {pc: count} of the last dump in a capture, skipping
+# anything else printed over UART.
+def read_samples(lines):
+    samples, inside = {}, False
+    for line in lines:
+        line = line.strip()
+        if line.startswith("PROFILE "):
+            samples, inside = {}, True
+        elif line == "END PROFILE":
+            inside = False
+        elif inside:
+            pc, count = line.split()
+            samples[int(pc, 16)] = samples.get(int(pc, 16), 0) + int(count)
+    return samples
+
+# Function: symbolize()
+# =-=-=-=-=-=-=-=-=-=-
+# Adds up the samples of every function and prints the busiest ones.
+def symbolize(samples, addresses, names):
+    functions = {}
+    for pc, count in samples.items():
+        i = bisect.bisect_right(addresses, pc) - 1
+        name = names[i] if i >= 0 else f'0x{pc:x}'
+        functions[name] = functions.get(name, 0) + count
+
+    total = sum(samples.values())
+    print(f'{total} samples')
+    for name, count in sorted(functions.items(), key=lambda item: -item[1])[:TOP]:
+        print(f'{100 * count / total:6.2f}% {count:8d}  {name}')
+
+# Main Program
+if len(sys.argv) < 2:
+    print("Usage: python3 profile_symbolize.py davinci.elf [capture]")
+    sys.exit(1)
+addresses, names = load_symbols(sys.argv[1])
+if len(sys.argv) > 2:
+    with open(sys.argv[2], errors="replace") as capture:
+        samples = read_samples(capture)
+else:
+    samples = read_samples(sys.stdin)
+if samples:
+    symbolize(samples, addresses, names)
+else:
+    print("No profile found in the capture.")
@@ -0,0 +1,59 @@
+# File: trace_decode.py
+# =-=-=-=-=-=-=-=-=-=-=
+# Decodes the binary motion trace sent over UART by `trace.c` into CSV.
+# Usage: python3 trace_decode.py [capture] > trace.csv (reads stdin
+# without a capture file). Bytes that are not part of a valid frame, such
+# as printf output on the same UART, are skipped.
+
+# Libraries
+import struct
+import sys
+
+# Constants
+SYNC = b'\xa5\x5a'
+RECORD = struct.Struct('<BBBBIiiiiiiI')
+FRAME_SIZE = len(SYNC) + RECORD.size + 1
+TYPES = {1: "move", 2: "vacuum", 3: "home", 4: "fault", 5: "brick", 6: "isr"}
+VACUUM_ON = 0x01
+AXES = ((0x02, "x"), (0x04, "y"), (0x08, "z"))
+COLUMNS = "seq,time_us,type,x,y,z,dx,dy,dz,speed,vacuum,axes,dropped"
+
+# Function: frames()
+# =-=-=-=-=-=-=-=-=-
+# Yields the record of every frame in `data` whose checksum matches.
+def frames(data):
+    i = data.find(SYNC)
+    while i >= 0 and i + FRAME_SIZE <= len(data):
+        record = data[i + len(SYNC):i + FRAME_SIZE - 1]
+        if sum(record) & 0xff == data[i + FRAME_SIZE - 1]:
+            yield RECORD.unpack(record)
+            i = data.find(SYNC, i + FRAME_SIZE)
+        else:
+            i = data.find(SYNC, i + 1)
+
+# Function: decode()
+# =-=-=-=-=-=-=-=-=-
+# Prints one CSV row per record, unwrapping the 32-bit timestamps (which
+# wrap every ~71 minutes) and counting the records missing before each one
+# (from gaps in `seq`).
+def decode(data, out):
+    out.write(COLUMNS + "\n")
+    last_seq = None
+    last_time = 0
+    wraps = 0
+    for kind, flags, speed, seq, time_us, x, y, z, dx, dy, dz, _ in frames(data):
+        if last_time - time_us > 1 << 31:
+            wraps += 1
+        last_time = time_us
+        dropped = 0 if last_seq is None else (seq - last_seq - 1) & 0xff
+        last_seq = seq
+        axes = "".join(name for bit, name in AXES if flags & bit)
+        out.write(f'{seq},{time_us + (wraps << 32)},{TYPES.get(kind, kind)},{x},{y},{z},{dx},{dy},{dz},'
+                  f'{speed},{1 if flags & VACUUM_ON else 0},{axes},{dropped}\n')
+
+# Main Program
+if len(sys.argv) > 1:
+    with open(sys.argv[1], "rb") as capture:
+        decode(capture.read(), sys.stdout)
+else:
+    decode(sys.stdin.buffer.read(), sys.stdout)
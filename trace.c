@@ -0,0 +1,134 @@
+/* File: trace.c
+ * =-=-=-=-=-=-=
+ * Ring of binary motion trace records, drained lazily over UART.
+ */
+
+// Standard Library Imports
+#include <stddef.h>
+
+// Library Imports
+#include "uart.h"
+
+// Project Imports
+#include "hal.h"
+#include "trace.h"
+
+// Constants
+#define FRAME_BYTES (2 + sizeof(struct trace_record) + 1)
+#define TRACE_BYTE_US 90 // one byte at 115200 baud takes ~87us, so the UART is always ready again by then
+
+// Ring of records (head is the next to write, tail the one being sent; both only ever grow)
+static struct trace_record ring[TRACE_RECORDS];
+static unsigned int head, tail;
+static unsigned int dropped;
+static unsigned char seq;
+static bool enabled = true;
+
+// Progress through the frame of the tail record
+static unsigned int frame_pos;
+static unsigned char frame_sum;
+static unsigned long last_byte_us;
+
+void trace_enable(bool on) {
+    enabled = on;
+}
+
+/* Function: push()
+ * =-=-=-=-=-=-=-=-
+ * Claims the next record of the ring, or returns NULL (and counts the
+ * drop) when the ring is full. Records are only written from the main
+ * loop, never from interrupts.
+ */
+static struct trace_record *push(enum trace_type type, bool vacuum) {
+    if(!enabled) return NULL;
+    struct trace_record *record = &ring[head % TRACE_RECORDS];
+    unsigned char number = seq++;
+    if(head - tail >= TRACE_RECORDS) {
+        dropped++;
+        return NULL;
+    }
+    record->type = type;
+    record->flags = vacuum ? TRACE_VACUUM_ON : 0;
+    record->speed = 0;
+    record->seq = number;
+    record->time_us = (unsigned int)hal_time_us();
+    record->dx = record->dy = record->dz = 0;
+    record->reserved = 0;
+    head++;
+    return record;
+}
+
+void trace_move(int x, int y, int z, int dx, int dy, int dz, int speed, bool vacuum) {
+    struct trace_record *record = push(TRACE_MOVE, vacuum);
+    if(!record) return;
+    if(dx) record->flags |= TRACE_AXIS_X;
+    if(dy) record->flags |= TRACE_AXIS_Y;
+    if(dz) record->flags |= TRACE_AXIS_Z;
+    record->speed = (speed > 255) ? 255 : speed;
+    record->x = x;
+    record->y = y;
+    record->z = z;
+    record->dx = dx;
+    record->dy = dy;
+    record->dz = dz;
+}
+
+void trace_event(enum trace_type type, int x, int y, int z, bool vacuum) {
+    struct trace_record *record = push(type, vacuum);
+    if(!record) return;
+    record->x = x;
+    record->y = y;
+    record->z = z;
+}
+
+void trace_stats(enum trace_type type, int x, int y, int z, int dx, int dy, int dz) {
+    struct trace_record *record = push(type, false);
+    if(!record) return;
+    record->x = x;
+    record->y = y;
+    record->z = z;
+    record->dx = dx;
+    record->dy = dy;
+    record->dz = dz;
+}
+
+/* Function: next_byte()
+ * =-=-=-=-=-=-=-=-=-=-=
+ * Returns the next byte of the tail record's frame, moving on to the
+ * following record once the checksum is out.
+ */
+static unsigned char next_byte(void) {
+    const unsigned char *bytes = (const unsigned char *)&ring[tail % TRACE_RECORDS];
+    unsigned char byte;
+    if(frame_pos == 0) byte = TRACE_SYNC_0;
+    else if(frame_pos == 1) byte = TRACE_SYNC_1;
+    else if(frame_pos < FRAME_BYTES - 1) {
+        byte = bytes[frame_pos - 2];
+        frame_sum += byte;
+    }
+    else byte = frame_sum;
+
+    if(++frame_pos == FRAME_BYTES) {
+        frame_pos = 0;
+        frame_sum = 0;
+        tail++;
+    }
+    return byte;
+}
+
+void trace_poll(void) {
+    if(head == tail) return;
+    unsigned long now = hal_time_us();
+    if(now - last_byte_us < TRACE_BYTE_US) return;
+    uart_send(next_byte());
+    last_byte_us = now;
+}
+
+void trace_flush(void) {
+    while(head != tail) uart_send(next_byte());
+    last_byte_us = hal_time_us();
+}
+
+unsigned int trace_dropped(void) {
+    return dropped;
+}
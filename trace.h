@@ -0,0 +1,129 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Binary trace of the motion code. Every move, vacuum switch, homing and
+ * fault is stored as a fixed 32-byte record in an in-memory ring, which
+ * is drained over UART a byte at a time while the driver waits on the
+ * steppers, so tracing never blocks a move (and is cheap enough to leave
+ * on). When the ring is full new records are dropped; the sequence
+ * number of each record shows where.
+ *
+ * On the wire every record is framed as
+ *
+ *     0xA5 0x5A <32-byte record, little endian> <checksum>
+ *
+ * where the checksum is the low byte of the sum of the record's bytes.
+ * `pyconversion/trace_decode.py` turns a capture into CSV.
+ */
+
+// Standard Library Imports
+#include <stdbool.h>
+
+// Constants
+#define TRACE_RECORDS 256
+#define TRACE_SYNC_0 0xA5
+#define TRACE_SYNC_1 0x5A
+
+// Record types
+enum trace_type {
+    TRACE_MOVE = 1,     // a move started: target {x, y, z}, steps {dx, dy, dz}
+    TRACE_VACUUM,       // the vacuum switched (flags), at {x, y, z}
+    TRACE_HOME,         // homing finished: x/y/z are 1 where the switch was found
+    TRACE_FAULT,        // a limit switch stopped the machine at {x, y, z}
+    TRACE_BRICK,        // a brick of the job was placed: x is its index
+    TRACE_ISR,          // stepper interrupt stats: x/y worst lateness/run (ns), z/dx/dy missed, overruns, ticks
+};
+
+// Record flags
+#define TRACE_VACUUM_ON 0x01
+#define TRACE_AXIS_X 0x02
+#define TRACE_AXIS_Y 0x04
+#define TRACE_AXIS_Z 0x08
+
+// Contains one trace record (32 bytes): its type, flags, speed class and sequence number, when it happened (low 32
+// bits of the microsecond clock), a position {x, y, z} and step counts {dx, dy, dz}
+struct trace_record {
+    unsigned char type, flags, speed, seq;
+    unsigned int time_us;
+    int x, y, z;
+    int dx, dy, dz;
+    unsigned int reserved;
+};
+
+/*
+ * `trace_enable`
+ *
+ * Turns tracing on or off (it is on at boot). Records already in the ring are still sent.
+ *
+ * @param on          true to record, false to drop every record
+ */
+void trace_enable(bool on);
+
+/*
+ * `trace_move`
+ *
+ * Records the start of a move.
+ *
+ * @param x           the target X position
+ * @param y           the target Y position
+ * @param z           the target Z position
+ * @param dx          the steps X moves (negative towards its switch)
+ * @param dy          the steps Y moves
+ * @param dz          the steps Z moves
+ * @param speed       the requested interval of the move (SPEED_MAX for top speed)
+ * @param vacuum      true if the vacuum is on
+ */
+void trace_move(int x, int y, int z, int dx, int dy, int dz, int speed, bool vacuum);
+
+/*
+ * `trace_event`
+ *
+ * Records an event without steps.
+ *
+ * @param type        TRACE_VACUUM, TRACE_HOME, TRACE_FAULT or TRACE_BRICK
+ * @param x           the X position (or the value described by `type`)
+ * @param y           the Y position
+ * @param z           the Z position
+ * @param vacuum      true if the vacuum is on
+ */
+void trace_event(enum trace_type type, int x, int y, int z, bool vacuum);
+
+/*
+ * `trace_stats`
+ *
+ * Records a set of counters, described by `type`, in the position and step fields.
+ *
+ * @param type        TRACE_ISR
+ * @param x           the first counter
+ * @param y           the second counter
+ * @param z           the third counter
+ * @param dx          the fourth counter
+ * @param dy          the fifth counter
+ * @param dz          the sixth counter
+ */
+void trace_stats(enum trace_type type, int x, int y, int z, int dx, int dy, int dz);
+
+/*
+ * `trace_poll`
+ *
+ * Sends the next byte of the ring over UART if the previous one has had time to go out (never blocks).
+ * Called from every loop that waits on the steppers.
+ */
+void trace_poll(void);
+
+/*
+ * `trace_flush`
+ *
+ * Sends everything left in the ring, waiting for the UART.
+ */
+void trace_flush(void);
+
+/*
+ * `trace_dropped`
+ *
+ * @return            the number of records dropped because the ring was full
+ */
+unsigned int trace_dropped(void);
+
+#endif